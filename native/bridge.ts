@@ -47,6 +47,15 @@ export interface PluginInfo {
   category?: string;
 }
 
+export interface PluginScanProgress {
+  format: string;
+  current: string;
+  progress: number;
+  found: number;
+  finished: boolean;
+  plugins?: PluginInfo[];
+}
+
 export interface PluginState {
   id: string;
   loaded: boolean;
@@ -55,6 +64,44 @@ export interface PluginState {
   latencySamples: number;
 }
 
+export interface VoiceAllocation {
+  mode: 'channel' | 'roundRobin' | 'mpeLower' | 'mpeUpper';
+  firstChannel?: number;
+  lastChannel?: number;
+  memberChannels?: number;
+}
+
+export interface StatsSummary {
+  count: number;
+  min: number;
+  avg: number;
+  max: number;
+  p99: number;
+}
+
+// Audio-callback counters; everything but `enabled` is absent when compiled out
+export interface EngineStats {
+  enabled: boolean;
+  blockMicros?: StatsSummary;
+  loadPercent?: StatsSummary;
+  eventsIn?: StatsSummary;
+  eventsOut?: StatsSummary;
+  hostedMicros?: StatsSummary;
+  hostedBlocksSkipped?: number;
+  bendsSent?: number;
+  voiceSteals?: number;
+  telemetryDropped?: number;
+  outputReallocations?: number;
+}
+
+export interface CaptureStatus {
+  recording: boolean;
+  overflowed: boolean;
+  blocks: number;
+  bytes: number;
+  path: string;
+}
+
 interface PendingRequest {
   resolve: (value: unknown) => void;
   reject: (error: Error) => void;
@@ -224,6 +271,33 @@ export class NativeBridge {
     });
   }
 
+  /**
+   * Sends a binary tuning frame (see TuningCodec.h). The native side skips JSON
+   * parsing for these and replies with an ordinary JSON-RPC response.
+   */
+  async callBinary<T>(encodeFrame: (requestId: number) => string): Promise<T> {
+    if (this.mockMode) {
+      return undefined as unknown as T;
+    }
+    if (!this.connected) {
+      throw new Error('Native bridge not connected');
+    }
+    const id = this.nextId++;
+    return new Promise<T>((resolve, reject) => {
+      const timeout = setTimeout(() => {
+        this.pending.delete(id);
+        reject(new Error('RPC timeout: binary frame'));
+      }, this.timeoutMs);
+      this.pending.set(id, {
+        resolve: resolve as (value: unknown) => void,
+        reject,
+        timeout,
+        method: 'binary',
+      });
+      this.postMessage(encodeFrame(id));
+    });
+  }
+
   on(event: string, handler: (params: Record<string, unknown>) => void): void {
     const eventName = event.startsWith('event.') ? event : `event.${event}`;
     let handlers = this.eventHandlers.get(eventName);
@@ -254,8 +328,24 @@ export class NativeBridge {
       case 'plugin.closeEditor': return undefined as unknown as T;
       case 'midi.send': return undefined as unknown as T;
       case 'midi.setTuning': return undefined as unknown as T;
-      case 'mts.register': return { clientId: `mock-mts-${Date.now()}` } as unknown as T;
-      case 'mts.broadcast': return undefined as unknown as T;
+      case 'midi.setNoteMapping': return undefined as unknown as T;
+      case 'midi.setHeldNoteRetune': return undefined as unknown as T;
+      case 'midi.setVoiceAllocation': return undefined as unknown as T;
+      case 'midi.setDynamicTuning': return undefined as unknown as T;
+      case 'midi.setOutputProtocol': return undefined as unknown as T;
+      case 'midi.setInputPitchBendRange': return undefined as unknown as T;
+      case 'midi.setTuningGroup': return undefined as unknown as T;
+      case 'midi.setPreset': return undefined as unknown as T;
+      case 'midi.selectPreset': return undefined as unknown as T;
+      case 'midi.setPresetSwitching': return undefined as unknown as T;
+      case 'midi.morphTables': return undefined as unknown as T;
+      case 'midi.transformTable': return undefined as unknown as T;
+      case 'getStats': return { enabled: false } as unknown as T;
+      case 'capture.start':
+      case 'capture.stop': return { recording: method === 'capture.start', overflowed: false, blocks: 0, bytes: 0, path: '' } as unknown as T;
+      case 'state.save': return { path: (params?.path as string | undefined) ?? '' } as unknown as T;
+      case 'mts.register': return { active: false, clients: 0 } as unknown as T;
+      case 'mts.broadcast': return false as unknown as T;
       case 'mts.getClientCount': return 0 as unknown as T;
       default: throw new Error(`Unknown method: ${method}`);
     }
@@ -296,6 +386,7 @@ export interface INativeBridge {
   setPluginParam(id: string, paramIndex: number, value: number): Promise<void>;
   openEditor(id: string): Promise<void>;
   closeEditor(id: string): Promise<void>;
+  onScanProgress(handler: (progress: PluginScanProgress) => void): () => void;
 }
 
 class NativeBridgeAdapter implements INativeBridge {
@@ -319,18 +410,122 @@ class NativeBridgeAdapter implements INativeBridge {
   async closeEditor(id: string): Promise<void> {
     await this.bridge.call('plugin.closeEditor', { id });
   }
+  onScanProgress(handler: (progress: PluginScanProgress) => void): () => void {
+    const listener = (params: Record<string, unknown>) => handler(params as unknown as PluginScanProgress);
+    this.bridge.on('pluginScan', listener);
+    return () => this.bridge.off('pluginScan', listener);
+  }
 }
 
 export const nativeBridgeCore = new NativeBridge();
 export const nativeBridge: INativeBridge = new NativeBridgeAdapter(nativeBridgeCore);
 
+const TUNING_FRAME_VERSION = 1;
+const TUNING_FRAME_FULL = 1;
+const TUNING_FRAME_DELTA = 2;
+const TUNING_FRAME_FREQUENCY_SET = 3;
+const MAX_FREQUENCY_SET = 512;
+
+const toTuningFrame = (bytes: Uint8Array): string => {
+  let binary = '';
+  for (let i = 0; i < bytes.length; i++) binary += String.fromCharCode(bytes[i]);
+  return `!${btoa(binary)}`;
+};
+
+const writeTuningFrameHeader = (view: DataView, type: number, requestId: number) => {
+  view.setUint8(0, 0x54); // 'T'
+  view.setUint8(1, 0x42); // 'B'
+  view.setUint8(2, TUNING_FRAME_VERSION);
+  view.setUint8(3, type);
+  view.setUint32(4, requestId, true);
+};
+
+export const encodeTuningTableFrame = (requestId: number, tuningTable: ArrayLike<number>): string => {
+  if (tuningTable.length !== 128) throw new Error('tuningTable must have 128 entries');
+  const view = new DataView(new ArrayBuffer(8 + 128 * 4));
+  writeTuningFrameHeader(view, TUNING_FRAME_FULL, requestId);
+  for (let i = 0; i < 128; i++) view.setFloat32(8 + i * 4, tuningTable[i], true);
+  return toTuningFrame(new Uint8Array(view.buffer));
+};
+
+export const encodeTuningDeltaFrame = (requestId: number, changes: ReadonlyArray<{ note: number; cents: number }>): string => {
+  if (changes.length > 128) throw new Error('At most 128 changes per delta frame');
+  const view = new DataView(new ArrayBuffer(9 + changes.length * 5));
+  writeTuningFrameHeader(view, TUNING_FRAME_DELTA, requestId);
+  view.setUint8(8, changes.length);
+  changes.forEach(({ note, cents }, i) => {
+    view.setUint8(9 + i * 5, note);
+    view.setFloat32(10 + i * 5, cents, true);
+  });
+  return toTuningFrame(new Uint8Array(view.buffer));
+};
+
+export const encodeFrequencySetFrame = (requestId: number, frequencies: ArrayLike<number>): string => {
+  if (frequencies.length > MAX_FREQUENCY_SET) throw new Error(`At most ${MAX_FREQUENCY_SET} frequencies per set`);
+  const view = new DataView(new ArrayBuffer(10 + frequencies.length * 8));
+  writeTuningFrameHeader(view, TUNING_FRAME_FREQUENCY_SET, requestId);
+  view.setUint16(8, frequencies.length, true);
+  for (let i = 0; i < frequencies.length; i++) view.setFloat64(10 + i * 8, frequencies[i], true);
+  return toTuningFrame(new Uint8Array(view.buffer));
+};
+
 export const midiRpc = {
   send: (bytes: number[]) => nativeBridgeCore.call('midi.send', { bytes }),
   setTuning: (tuningTable: number[]) => nativeBridgeCore.call('midi.setTuning', { tuningTable }),
+  setTuningBinary: (tuningTable: ArrayLike<number>) =>
+    nativeBridgeCore.callBinary((id) => encodeTuningTableFrame(id, tuningTable)),
+  setTuningDelta: (changes: ReadonlyArray<{ note: number; cents: number }>) =>
+    nativeBridgeCore.callBinary((id) => encodeTuningDeltaFrame(id, changes)),
+  // Hz, any order; an empty set returns to table tuning
+  setFrequencySet: (frequencies: ArrayLike<number>) =>
+    nativeBridgeCore.callBinary((id) => encodeFrequencySetFrame(id, frequencies)),
+  setNoteMapping: (mode: 'sameKey' | 'nearestKey') => nativeBridgeCore.call('midi.setNoteMapping', { mode }),
+  setHeldNoteRetune: (mode: 'off' | 'immediate' | 'glide', glideMs?: number) =>
+    nativeBridgeCore.call('midi.setHeldNoteRetune', { mode, glideMs }),
+  setVoiceAllocation: (allocation: VoiceAllocation) => nativeBridgeCore.call('midi.setVoiceAllocation', { ...allocation }),
+  // Retunes each new note against the held chord; 'off' returns to static tuning
+  setDynamicTuning: (strategy: 'off' | 'adaptiveJust') => nativeBridgeCore.call('midi.setDynamicTuning', { strategy }),
+  // MIDI 2.0 reaches destinations that take UMP; the rest keep getting MIDI 1.0
+  setOutputProtocol: (protocol: 'midi1' | 'midi2PitchAttribute' | 'midi2PerNoteBend') =>
+    nativeBridgeCore.call('midi.setOutputProtocol', { protocol }),
+  // Range of the performer's pitch wheel, which is added to every voice's tuning; 0 ignores it
+  setInputPitchBendRange: (semitones: number) => nativeBridgeCore.call('midi.setInputPitchBendRange', { semitones }),
+  // Instances in the same host process and group play one table; '' plays alone
+  setTuningGroup: (group: string) => nativeBridgeCore.call('midi.setTuningGroup', { group }),
+  // Presets are 0-based; the native side keeps TuningEngine::maxPresets of them
+  setPreset: (index: number, tuningTable: number[]) => nativeBridgeCore.call('midi.setPreset', { index, tuningTable }),
+  selectPreset: (index: number) => nativeBridgeCore.call('midi.selectPreset', { index }),
+  setPresetSwitching: (programChange: boolean, controller?: number) =>
+    nativeBridgeCore.call('midi.setPresetSwitching', { programChange, controller: controller ?? -1 }),
+  // Both write the selected preset from stored ones, and can be sent once per animation
+  // frame. A source may be the selected preset itself, read as it was before the call, so
+  // repeated calls from it compound. amount 0..1 runs from 'from' to 'to';
+  // stretch scales every pitch about A4 (1 leaves it), transposeCents shifts them all.
+  morphTables: (from: number, to: number, amount: number, stretch = 1, transposeCents = 0) =>
+    nativeBridgeCore.call('midi.morphTables', { from, to, amount, stretch, transposeCents }),
+  transformTable: (source: number, stretch: number, transposeCents: number) =>
+    nativeBridgeCore.call('midi.transformTable', { source, stretch, transposeCents }),
+};
+
+export const statsRpc = {
+  get: () => nativeBridgeCore.call<EngineStats>('getStats'),
+};
+
+// Records input and engine state for TuningEngineReplay; path defaults to Documents/TuningMiddleware/Captures
+export const captureRpc = {
+  start: (path?: string) => nativeBridgeCore.call<CaptureStatus>('capture.start', path ? { path } : {}),
+  stop: () => nativeBridgeCore.call<CaptureStatus>('capture.stop'),
+};
+
+// Saves the engine's tuning and settings for TuningMiddlewareBatch --state
+export const stateRpc = {
+  save: (path?: string) => nativeBridgeCore.call<{ path: string }>('state.save', path ? { path } : {}),
 };
 
+// The host broadcasts its own tuning on every edit while it is the MTS-ESP master.
+// broadcast() sends 128 frequencies in Hz instead, until the next edit.
 export const mtsRpc = {
-  register: () => nativeBridgeCore.call<{ clientId: string }>('mts.register'),
-  broadcast: (tuningTable: number[]) => nativeBridgeCore.call('mts.broadcast', { tuningTable }),
+  register: () => nativeBridgeCore.call<{ active: boolean; clients: number }>('mts.register'),
+  broadcast: (tuningTable: number[]) => nativeBridgeCore.call<boolean>('mts.broadcast', { tuningTable }),
   getClientCount: () => nativeBridgeCore.call<number>('mts.getClientCount'),
 };
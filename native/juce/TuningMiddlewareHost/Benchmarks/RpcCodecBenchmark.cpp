@@ -0,0 +1,93 @@
+/*
+    RpcCodecBenchmark - JSON vs binary decoding of midi.setTuning payloads
+
+    Prints one JSON object per line so results can be collected by scripts:
+        RpcCodecBenchmark [iterations]
+*/
+
+#include <JuceHeader.h>
+#include "../Source/TuningCodec.h"
+#include <iostream>
+
+namespace
+{
+    volatile float sink = 0.0f;
+
+    template <typename Callback>
+    double measureNanosPerCall(int iterations, Callback&& callback)
+    {
+        // Warm up caches and lazily initialised tables before timing
+        for (int i = 0; i < iterations / 10 + 1; ++i)
+            callback();
+
+        auto start = juce::Time::getHighResolutionTicks();
+
+        for (int i = 0; i < iterations; ++i)
+            callback();
+
+        auto elapsed = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start);
+        return elapsed * 1.0e9 / iterations;
+    }
+
+    // Same work RpcBridge does for a JSON midi.setTuning request
+    void decodeJson(const juce::String& request, std::array<float, 128>& table)
+    {
+        auto json = juce::JSON::parse(request);
+        auto tuningArray = json.getProperty("params", juce::var()).getProperty("tuningTable", juce::var());
+
+        for (int i = 0; i < 128; ++i)
+            table[(size_t) i] = static_cast<float>(tuningArray[i]);
+    }
+
+    void report(const char* path, const juce::String& payload, double nanosPerCall)
+    {
+        std::cout << "{\"benchmark\":\"rpc.setTuning\",\"path\":\"" << path
+                  << "\",\"payloadBytes\":" << payload.getNumBytesAsUTF8()
+                  << ",\"nsPerCall\":" << nanosPerCall << "}" << std::endl;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    auto iterations = argc > 1 ? juce::jmax(1, juce::String(argv[1]).getIntValue()) : 20000;
+
+    // A slightly irregular table, similar to what the lattice produces
+    std::array<float, 128> cents;
+    for (int note = 0; note < 128; ++note)
+        cents[(size_t) note] = std::sin(static_cast<float>(note) * 0.7f) * 31.4159f;
+
+    juce::String jsonRequest = "{\"jsonrpc\":\"2.0\",\"id\":1,\"method\":\"midi.setTuning\",\"params\":{\"tuningTable\":[";
+    for (int note = 0; note < 128; ++note)
+        jsonRequest << (note > 0 ? "," : "") << juce::String(cents[(size_t) note], 6);
+    jsonRequest << "]}}";
+
+    auto fullFrame = TuningCodec::encodeFullTable(1, cents);
+
+    // Dragging one lattice node usually moves a handful of keys
+    const juce::uint8 deltaNotes[] = { 60, 72, 84, 96 };
+    const float deltaCents[] = { 3.5f, 3.5f, 3.5f, 3.5f };
+    auto deltaFrame = TuningCodec::encodeDelta(1, deltaNotes, deltaCents, 4);
+
+    std::array<float, 128> table;
+    TuningCodec::Frame frame;
+
+    report("json", jsonRequest, measureNanosPerCall(iterations, [&]
+    {
+        decodeJson(jsonRequest, table);
+        sink = sink + table[69];
+    }));
+
+    report("binaryFull", fullFrame, measureNanosPerCall(iterations, [&]
+    {
+        TuningCodec::decode(fullFrame.toRawUTF8(), fullFrame.getNumBytesAsUTF8(), frame);
+        sink = sink + frame.cents[69];
+    }));
+
+    report("binaryDelta", deltaFrame, measureNanosPerCall(iterations, [&]
+    {
+        TuningCodec::decode(deltaFrame.toRawUTF8(), deltaFrame.getNumBytesAsUTF8(), frame);
+        sink = sink + frame.cents[0];
+    }));
+
+    return 0;
+}
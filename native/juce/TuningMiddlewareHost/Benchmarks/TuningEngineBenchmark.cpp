@@ -0,0 +1,269 @@
+/*
+    TuningEngineBenchmark - Throughput and worst-case latency of TuningEngine
+
+    Drives synthetic MIDI workloads through the engine at several block sizes and
+    prints one JSON object per line (workload x output protocol x block size):
+        TuningEngineBenchmark [seconds of audio per run]
+*/
+
+#include <JuceHeader.h>
+#include "../Source/TuningEngine.h"
+#include "../Source/AllocationTracker.h"
+#include "../Source/BlockStats.h"
+#include <iostream>
+
+namespace
+{
+    constexpr double sampleRate = 48000.0;
+
+    enum class Workload
+    {
+        sparseMelody,     // one note at a time, four per second
+        denseChords,      // eight-note chords every 2048 samples
+        denseChords12TET, // the same over an untuned table, where every bend is centred
+        ccFlood,          // mod wheel every 4 samples over a slow melody
+        mpeStream,        // eight MPE voices with per-channel bends and pressure
+        adaptiveJust32    // 32 held voices, one replaced every 256 samples, dynamic JI on
+    };
+
+    const char* getName(Workload workload)
+    {
+        switch (workload)
+        {
+            case Workload::sparseMelody:     return "sparseMelody";
+            case Workload::denseChords:      return "denseChords";
+            case Workload::denseChords12TET: return "denseChords12TET";
+            case Workload::ccFlood:          return "ccFlood";
+            case Workload::mpeStream:        return "mpeStream";
+            case Workload::adaptiveJust32:   return "adaptiveJust32";
+        }
+
+        return "unknown";
+    }
+
+    // Adds the workload's events for sample times [blockStart, blockStart + numSamples)
+    void fillBlock(Workload workload, juce::int64 blockStart, int numSamples, juce::MidiBuffer& buffer)
+    {
+        buffer.clear();
+
+        for (int offset = 0; offset < numSamples; ++offset)
+        {
+            auto time = blockStart + offset;
+
+            switch (workload)
+            {
+                case Workload::sparseMelody:
+                {
+                    auto step = time / 12000;
+                    auto note = 48 + static_cast<int>((step * 7) % 36);
+
+                    if (time % 12000 == 0)
+                        buffer.addEvent(juce::MidiMessage::noteOn(1, note, (juce::uint8) 100), offset);
+                    else if (time % 12000 == 9000)
+                        buffer.addEvent(juce::MidiMessage::noteOff(1, note), offset);
+                    break;
+                }
+
+                case Workload::denseChords:
+                case Workload::denseChords12TET:
+                {
+                    auto root = 36 + static_cast<int>(((time / 2048) * 5) % 48);
+
+                    if (time % 2048 == 0 || time % 2048 == 1024)
+                        for (int i = 0; i < 8; ++i)
+                            buffer.addEvent(time % 2048 == 0 ? juce::MidiMessage::noteOn(1, root + i * 3, (juce::uint8) 90)
+                                                             : juce::MidiMessage::noteOff(1, root + i * 3), offset);
+                    break;
+                }
+
+                case Workload::ccFlood:
+                {
+                    if (time % 4 == 0)
+                        buffer.addEvent(juce::MidiMessage::controllerEvent(1, 1, static_cast<int>((time / 4) % 128)), offset);
+
+                    auto note = 60 + static_cast<int>((time / 4096) % 12);
+
+                    if (time % 4096 == 0)
+                        buffer.addEvent(juce::MidiMessage::noteOn(1, note, (juce::uint8) 100), offset);
+                    else if (time % 4096 == 3000)
+                        buffer.addEvent(juce::MidiMessage::noteOff(1, note), offset);
+                    break;
+                }
+
+                case Workload::mpeStream:
+                {
+                    for (int voice = 0; voice < 8; ++voice)
+                    {
+                        auto channel = 2 + voice;
+                        auto phase = (time + voice * 600) % 9600;
+                        auto note = 48 + voice * 4;
+
+                        if (phase == 0)
+                            buffer.addEvent(juce::MidiMessage::noteOn(channel, note, (juce::uint8) 100), offset);
+                        else if (phase == 7200)
+                            buffer.addEvent(juce::MidiMessage::noteOff(channel, note), offset);
+                        else if (phase < 7200 && phase % 64 == 0)
+                        {
+                            buffer.addEvent(juce::MidiMessage::pitchWheel(channel, 8192 + static_cast<int>((phase / 64) % 400) - 200), offset);
+                            buffer.addEvent(juce::MidiMessage::channelPressureChange(channel, static_cast<int>((phase / 64) % 128)), offset);
+                        }
+                    }
+                    break;
+                }
+
+                case Workload::adaptiveJust32:
+                {
+                    // 60 steps between repeats, so the 32 held keys are always distinct
+                    auto keyAt = [](juce::int64 step) { return 36 + static_cast<int>((step * 7) % 60); };
+
+                    if (time % 256 == 0)
+                    {
+                        auto step = time / 256;
+
+                        if (step >= 32)
+                            buffer.addEvent(juce::MidiMessage::noteOff(1, keyAt(step - 32)), offset);
+
+                        buffer.addEvent(juce::MidiMessage::noteOn(1, keyAt(step), (juce::uint8) 100), offset);
+                    }
+                    break;
+                }
+            }
+        }
+    }
+
+    const char* getName(TuningEngine::OutputProtocol protocol)
+    {
+        switch (protocol)
+        {
+            case TuningEngine::OutputProtocol::midi1:               return "midi1";
+            case TuningEngine::OutputProtocol::midi2PitchAttribute: return "midi2PitchAttribute";
+            case TuningEngine::OutputProtocol::midi2PerNoteBend:    return "midi2PerNoteBend";
+        }
+
+        return "unknown";
+    }
+
+    int countNoteOns(const juce::MidiBuffer& buffer)
+    {
+        int numNoteOns = 0;
+        for (const auto metadata : buffer)
+            if (metadata.getMessage().isNoteOn())
+                ++numNoteOns;
+
+        return numNoteOns;
+    }
+
+    void configure(TuningEngine& engine, Workload workload)
+    {
+        std::array<float, 128> cents {};
+        if (workload != Workload::denseChords12TET)
+            for (int note = 0; note < 128; ++note)
+                cents[(size_t) note] = static_cast<float>((note * 37) % 100 - 50);
+
+        engine.setTuning(cents, 2.0f);
+        engine.setNoteMapping(TuningEngine::NoteMapping::nearestKey);
+
+        VoiceAllocator::Config allocation;
+        allocation.mode = workload == Workload::mpeStream ? VoiceAllocator::Mode::mpeLowerZone
+                                                          : VoiceAllocator::Mode::roundRobin;
+
+        if (workload == Workload::adaptiveJust32)
+        {
+            // Channel rotation would steal voices beyond 16, so keep notes where they are
+            allocation.mode = VoiceAllocator::Mode::inputChannel;
+            engine.setRetuningStrategy(RetuningStrategy::create(AdaptiveJustStrategy::name));
+        }
+
+        engine.setVoiceAllocation(allocation);
+    }
+
+    void run(Workload workload, TuningEngine::OutputProtocol protocol, int blockSize, double seconds)
+    {
+        TuningEngine engine;
+        configure(engine, workload);
+        engine.setOutputProtocol(protocol);
+        engine.prepare(sampleRate, blockSize);
+
+        juce::MidiBuffer buffer;
+        buffer.ensureSize(65536);
+
+        // MIDI 1.0 runs go without a packet destination, as a MIDI 1.0 host would
+        UmpBuffer packets;
+        packets.ensureSize(engine.getMaxEventsPerBlock() * 2);
+        auto* umpOutput = protocol != TuningEngine::OutputProtocol::midi1 ? &packets : nullptr;
+
+        auto numBlocks = static_cast<int>(seconds * sampleRate / blockSize);
+        juce::int64 eventsIn = 0, eventsOut = 0, noteOns = 0, totalTicks = 0, worstTicks = 0;
+        double worstTicksPerNoteOn = 0.0;
+        auto allocationsBefore = AllocationTracker::getNumRealtimeAllocations();
+
+        BlockStats::AudioCallback blockStats;
+        blockStats.prepare(sampleRate);
+
+        for (int block = 0; block < numBlocks; ++block)
+        {
+            fillBlock(workload, static_cast<juce::int64>(block) * blockSize, blockSize, buffer);
+            auto blockEventsIn = buffer.getNumEvents();
+            eventsIn += blockEventsIn;
+            auto numNoteOns = countNoteOns(buffer);
+            noteOns += numNoteOns;
+
+            auto start = juce::Time::getHighResolutionTicks();
+
+            {
+                const AllocationTracker::ScopedRealtimeSection realtimeSection;
+                engine.processBlock(buffer, blockSize, umpOutput);
+            }
+
+            auto ticks = juce::Time::getHighResolutionTicks() - start;
+            totalTicks += ticks;
+            worstTicks = juce::jmax(worstTicks, ticks);
+
+            // Whole block cost charged to its note-ons; tight at small block sizes
+            if (numNoteOns > 0)
+                worstTicksPerNoteOn = juce::jmax(worstTicksPerNoteOn, static_cast<double>(ticks) / numNoteOns);
+
+            auto blockEventsOut = umpOutput != nullptr ? umpOutput->getNumEvents() : buffer.getNumEvents();
+            eventsOut += blockEventsOut;
+
+            blockStats.recordEngine(ticks, blockEventsIn, blockEventsOut);
+            blockStats.recordLoad(ticks, blockSize);
+        }
+
+        auto toNanos = [](juce::int64 ticks) { return juce::Time::highResolutionTicksToSeconds(ticks) * 1.0e9; };
+
+        std::cout << "{\"benchmark\":\"tuningEngine\""
+                  << ",\"workload\":\"" << getName(workload) << "\""
+                  << ",\"protocol\":\"" << getName(protocol) << "\""
+                  << ",\"blockSize\":" << blockSize
+                  << ",\"blocks\":" << numBlocks
+                  << ",\"eventsIn\":" << eventsIn
+                  << ",\"eventsOut\":" << eventsOut
+                  << ",\"messagesPerNote\":" << (noteOns > 0 ? static_cast<double>(eventsOut) / static_cast<double>(noteOns) : 0.0)
+                  << ",\"nsPerEvent\":" << (eventsIn > 0 ? toNanos(totalTicks) / static_cast<double>(eventsIn) : 0.0)
+                  << ",\"nsPerBlockAvg\":" << toNanos(totalTicks) / juce::jmax(1, numBlocks)
+                  << ",\"nsPerBlockWorst\":" << toNanos(worstTicks)
+                  << ",\"nsPerBlockP99\":" << blockStats.getEngineTime().p99 * 1000.0
+                  << ",\"loadPercentP99\":" << blockStats.getLoad().p99
+                  << ",\"nsPerNoteOnWorst\":" << toNanos(static_cast<juce::int64>(worstTicksPerNoteOn))
+                  << ",\"allocations\":" << AllocationTracker::getNumRealtimeAllocations() - allocationsBefore
+                  << ",\"outputReallocations\":" << engine.getNumOutputReallocations()
+                  << ",\"bendsSent\":" << engine.getNumBendsSent()
+                  << ",\"voiceSteals\":" << engine.getNumVoiceSteals()
+                  << "}" << std::endl;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    auto seconds = argc > 1 ? juce::jmax(0.1, juce::String(argv[1]).getDoubleValue()) : 10.0;
+
+    for (auto workload : { Workload::sparseMelody, Workload::denseChords, Workload::denseChords12TET, Workload::ccFlood,
+                           Workload::mpeStream, Workload::adaptiveJust32 })
+        for (auto protocol : { TuningEngine::OutputProtocol::midi1, TuningEngine::OutputProtocol::midi2PitchAttribute,
+                               TuningEngine::OutputProtocol::midi2PerNoteBend })
+            for (auto blockSize : { 32, 64, 128, 256, 512, 1024 })
+                run(workload, protocol, blockSize, seconds);
+
+    return 0;
+}
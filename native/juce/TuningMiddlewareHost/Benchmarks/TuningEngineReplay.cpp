@@ -0,0 +1,235 @@
+/*
+    TuningEngineReplay - Plays a MIDI capture back through a fresh TuningEngine
+
+    Feeds every captured block through the engine at full speed, restoring the
+    captured state where it changed, and prints one JSON object with the
+    throughput. With a golden file the output is compared block for block:
+        TuningEngineReplay <capture.tmcap> [--golden <file> [--update-golden]] [--repeat <n>]
+
+    --update-golden writes this build's output as the golden file instead.
+    Exits with 1 when the output doesn't match or a file can't be used.
+*/
+
+#include <JuceHeader.h>
+#include "../Source/TuningEngine.h"
+#include "../Source/MidiCapture.h"
+#include "../Source/BlockStats.h"
+#include "../Source/AllocationTracker.h"
+#include "../Source/UmpBuffer.h"
+#include <iostream>
+
+namespace
+{
+    struct Options
+    {
+        juce::File capture;
+        juce::File golden;
+        bool updateGolden = false;
+        int repeat = 1;
+    };
+
+    bool parseOptions(int argc, char* argv[], Options& options)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            juce::String arg(argv[i]);
+
+            if (arg == "--golden" && i + 1 < argc)
+                options.golden = juce::File::getCurrentWorkingDirectory().getChildFile(argv[++i]);
+            else if (arg == "--update-golden")
+                options.updateGolden = true;
+            else if (arg == "--repeat" && i + 1 < argc)
+                options.repeat = juce::jmax(1, juce::String(argv[++i]).getIntValue());
+            else if (! arg.startsWith("--") && options.capture == juce::File())
+                options.capture = juce::File::getCurrentWorkingDirectory().getChildFile(arg);
+            else
+                return false;
+        }
+
+        return options.capture != juce::File() && (! options.updateGolden || options.golden != juce::File());
+    }
+
+    struct Result
+    {
+        std::vector<juce::MemoryBlock> output;
+        BlockStats::AudioCallback stats;
+        juce::int64 eventsIn = 0, eventsOut = 0, totalTicks = 0;
+        int allocations = 0, outputReallocations = 0;
+    };
+
+    // One pass over the whole capture; the output is kept only when asked for
+    void replay(const MidiCapture::Capture& capture, Result& result, bool keepOutput)
+    {
+        TuningEngine engine;
+        engine.setMaxEventsPerBlock(capture.maxEventsPerBlock);
+        engine.prepare(capture.sampleRate, capture.blockSize);
+
+        juce::MidiBuffer buffer;
+        buffer.ensureSize(65536);
+
+        UmpBuffer packets;
+        packets.ensureSize(engine.getMaxEventsPerBlock() * 2);
+        auto* umpOutput = capture.midi2Destination ? &packets : nullptr;
+
+        for (const auto& block : capture.blocks)
+        {
+            // State edits happened on another thread, so they stay out of the timing
+            MidiCapture::prepareEngine(capture, block, engine);
+
+            buffer.clear();
+            buffer.addEvents(block.input, 0, -1, 0);
+            auto eventsIn = buffer.getNumEvents();
+
+            auto allocationsBefore = AllocationTracker::getNumRealtimeAllocations();
+            juce::int64 ticks;
+
+            {
+                const AllocationTracker::ScopedRealtimeSection realtimeSection;
+                const BlockStats::Stopwatch stopwatch;
+                engine.processBlock(buffer, block.numSamples, umpOutput);
+                ticks = stopwatch.getElapsedTicks();
+            }
+
+            result.allocations += AllocationTracker::getNumRealtimeAllocations() - allocationsBefore;
+
+            // MIDI 2.0 output leaves the MIDI buffer empty, so the packets are the output when there are any
+            const UmpBuffer* rendered = umpOutput != nullptr && ! packets.isEmpty() ? &packets : nullptr;
+            auto eventsOut = rendered != nullptr ? rendered->getNumEvents() : buffer.getNumEvents();
+            result.stats.recordEngine(ticks, eventsIn, eventsOut);
+            result.stats.recordLoad(ticks, block.numSamples);
+            result.totalTicks += ticks;
+            result.eventsIn += eventsIn;
+            result.eventsOut += eventsOut;
+
+            if (keepOutput)
+            {
+                juce::MemoryBlock encoded;
+                juce::MemoryOutputStream stream(encoded, false);
+                MidiCapture::encodeOutput(buffer, rendered, stream);
+                stream.flush();
+                result.output.push_back(std::move(encoded));
+            }
+        }
+
+        result.outputReallocations += engine.getNumOutputReallocations();
+    }
+
+    // Index of the first block that differs, or -1; counts every differing block
+    int compare(const std::vector<juce::MemoryBlock>& expected, const std::vector<juce::MemoryBlock>& actual, int& numMismatched)
+    {
+        auto numBlocks = juce::jmax(expected.size(), actual.size());
+        int first = -1;
+        numMismatched = 0;
+
+        for (size_t i = 0; i < numBlocks; ++i)
+        {
+            if (i < expected.size() && i < actual.size() && expected[i] == actual[i])
+                continue;
+
+            ++numMismatched;
+
+            if (first < 0)
+                first = (int) i;
+        }
+
+        return first;
+    }
+
+    juce::String toHex(const std::vector<juce::MemoryBlock>& blocks, int index)
+    {
+        if (! juce::isPositiveAndBelow(index, (int) blocks.size()))
+            return "(missing)";
+
+        const auto& block = blocks[(size_t) index];
+        return juce::String::toHexString(block.getData(), (int) block.getSize());
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+
+    if (! parseOptions(argc, argv, options))
+    {
+        std::cerr << "usage: TuningEngineReplay <capture.tmcap> [--golden <file> [--update-golden]] [--repeat <n>]" << std::endl;
+        return 1;
+    }
+
+    MidiCapture::Capture capture;
+    juce::String error;
+
+    if (! MidiCapture::readCapture(options.capture, capture, error))
+    {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+
+    Result result;
+    result.stats.prepare(capture.sampleRate);
+    auto wantOutput = options.golden != juce::File();
+
+    for (int pass = 0; pass < options.repeat; ++pass)
+        replay(capture, result, wantOutput && pass == 0);
+
+    juce::String golden = "none";
+    int numMismatched = 0, firstMismatch = -1;
+
+    if (options.updateGolden)
+    {
+        if (! MidiCapture::writeGolden(options.golden, result.output, error))
+        {
+            std::cerr << error << std::endl;
+            return 1;
+        }
+
+        golden = "written";
+    }
+    else if (wantOutput)
+    {
+        std::vector<juce::MemoryBlock> expected;
+
+        if (! MidiCapture::readGolden(options.golden, expected, error))
+        {
+            std::cerr << error << std::endl;
+            return 1;
+        }
+
+        firstMismatch = compare(expected, result.output, numMismatched);
+        golden = firstMismatch < 0 ? "match" : "mismatch";
+
+        if (firstMismatch >= 0)
+            std::cerr << "block " << firstMismatch << " differs" << std::endl
+                      << "  expected " << toHex(expected, firstMismatch) << std::endl
+                      << "  actual   " << toHex(result.output, firstMismatch) << std::endl;
+    }
+
+    juce::int64 numSamples = 0;
+    for (const auto& block : capture.blocks)
+        numSamples += block.numSamples;
+
+    auto audioSeconds = (double) numSamples * options.repeat / capture.sampleRate;
+    auto processingSeconds = juce::Time::highResolutionTicksToSeconds(result.totalTicks);
+    auto numBlocks = (juce::int64) capture.blocks.size() * options.repeat;
+    auto blockTime = result.stats.getEngineTime();
+
+    std::cout << "{\"benchmark\":\"tuningEngineReplay\""
+              << ",\"capture\":\"" << options.capture.getFileName() << "\""
+              << ",\"blocks\":" << numBlocks
+              << ",\"snapshots\":" << capture.snapshots.size()
+              << ",\"eventsIn\":" << result.eventsIn
+              << ",\"eventsOut\":" << result.eventsOut
+              << ",\"audioSeconds\":" << audioSeconds
+              << ",\"realtimeFactor\":" << (processingSeconds > 0.0 ? audioSeconds / processingSeconds : 0.0)
+              << ",\"nsPerEvent\":" << (result.eventsIn > 0 ? processingSeconds * 1.0e9 / (double) result.eventsIn : 0.0)
+              << ",\"nsPerBlockAvg\":" << blockTime.average * 1000.0
+              << ",\"nsPerBlockP99\":" << blockTime.p99 * 1000.0
+              << ",\"nsPerBlockWorst\":" << blockTime.max * 1000.0
+              << ",\"allocations\":" << result.allocations
+              << ",\"outputReallocations\":" << result.outputReallocations
+              << ",\"golden\":\"" << golden << "\""
+              << ",\"mismatchedBlocks\":" << numMismatched
+              << ",\"firstMismatch\":" << firstMismatch
+              << "}" << std::endl;
+
+    return firstMismatch < 0 ? 0 : 1;
+}
@@ -0,0 +1,96 @@
+#include "AllocationTracker.h"
+
+#if TUNING_MIDDLEWARE_TRACK_ALLOCATIONS
+
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+    thread_local int realtimeSectionDepth = 0;
+    std::atomic<int> numRealtimeAllocations { 0 };
+
+    void* trackedAllocate(std::size_t size)
+    {
+        if (realtimeSectionDepth > 0)
+            numRealtimeAllocations.fetch_add(1, std::memory_order_relaxed);
+
+        if (auto* ptr = std::malloc(size == 0 ? 1 : size))
+            return ptr;
+
+        throw std::bad_alloc();
+    }
+
+    void* trackedAllocate(std::size_t size, std::align_val_t alignment)
+    {
+        if (realtimeSectionDepth > 0)
+            numRealtimeAllocations.fetch_add(1, std::memory_order_relaxed);
+
+        // aligned_alloc() wants the size in whole multiples of the alignment
+        auto align = juce::jmax(sizeof(void*), static_cast<std::size_t>(alignment));
+        auto rounded = (juce::jmax(size, (std::size_t) 1) + align - 1) / align * align;
+
+       #if JUCE_WINDOWS
+        if (auto* ptr = _aligned_malloc(rounded, align))
+       #else
+        if (auto* ptr = std::aligned_alloc(align, rounded))
+       #endif
+            return ptr;
+
+        throw std::bad_alloc();
+    }
+
+    void trackedFreeAligned(void* ptr) noexcept
+    {
+       #if JUCE_WINDOWS
+        _aligned_free(ptr);
+       #else
+        std::free(ptr);
+       #endif
+    }
+
+    template <typename Allocate>
+    void* allocateNoThrow(Allocate&& allocate) noexcept
+    {
+        try { return allocate(); }
+        catch (const std::bad_alloc&) { return nullptr; }
+    }
+}
+
+namespace AllocationTracker
+{
+    ScopedRealtimeSection::ScopedRealtimeSection()  { ++realtimeSectionDepth; }
+    ScopedRealtimeSection::~ScopedRealtimeSection() { --realtimeSectionDepth; }
+
+    int getNumRealtimeAllocations()
+    {
+        return numRealtimeAllocations.load(std::memory_order_relaxed);
+    }
+}
+
+// Replacing the global operators keeps the check independent of which library
+// (JUCE or the STL) performs the allocation. Every replaceable form is covered,
+// so no allocation falls through to the runtime's own operators.
+void* operator new(std::size_t size)               { return trackedAllocate(size); }
+void* operator new[](std::size_t size)             { return trackedAllocate(size); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept   { return allocateNoThrow([=] { return trackedAllocate(size); }); }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { return allocateNoThrow([=] { return trackedAllocate(size); }); }
+void  operator delete(void* ptr) noexcept          { std::free(ptr); }
+void  operator delete[](void* ptr) noexcept        { std::free(ptr); }
+void  operator delete(void* ptr, std::size_t) noexcept   { std::free(ptr); }
+void  operator delete[](void* ptr, std::size_t) noexcept { std::free(ptr); }
+void  operator delete(void* ptr, const std::nothrow_t&) noexcept   { std::free(ptr); }
+void  operator delete[](void* ptr, const std::nothrow_t&) noexcept { std::free(ptr); }
+
+void* operator new(std::size_t size, std::align_val_t alignment)   { return trackedAllocate(size, alignment); }
+void* operator new[](std::size_t size, std::align_val_t alignment) { return trackedAllocate(size, alignment); }
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept   { return allocateNoThrow([=] { return trackedAllocate(size, alignment); }); }
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return allocateNoThrow([=] { return trackedAllocate(size, alignment); }); }
+void  operator delete(void* ptr, std::align_val_t) noexcept                     { trackedFreeAligned(ptr); }
+void  operator delete[](void* ptr, std::align_val_t) noexcept                   { trackedFreeAligned(ptr); }
+void  operator delete(void* ptr, std::size_t, std::align_val_t) noexcept        { trackedFreeAligned(ptr); }
+void  operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept      { trackedFreeAligned(ptr); }
+void  operator delete(void* ptr, std::align_val_t, const std::nothrow_t&) noexcept   { trackedFreeAligned(ptr); }
+void  operator delete[](void* ptr, std::align_val_t, const std::nothrow_t&) noexcept { trackedFreeAligned(ptr); }
+
+#endif
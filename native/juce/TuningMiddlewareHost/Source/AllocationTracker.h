@@ -0,0 +1,43 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+/**
+ * AllocationTracker - Flags heap allocations made on the audio thread
+ *
+ * When enabled, the global operator new counts every allocation made while a
+ * ScopedRealtimeSection is alive on the calling thread. Replacing the global
+ * operators in a plugin would replace them for the whole host, so only the
+ * benchmark and replay executables define TUNING_MIDDLEWARE_TRACK_ALLOCATIONS;
+ * the plugin relies on TuningEngine::getNumOutputReallocations() instead.
+ *
+ * malloc() and realloc() are not seen, and JUCE's HeapBlock uses them, which is
+ * why the engine checks its own buffers' capacity as well.
+ */
+#ifndef TUNING_MIDDLEWARE_TRACK_ALLOCATIONS
+ #define TUNING_MIDDLEWARE_TRACK_ALLOCATIONS 0
+#endif
+
+namespace AllocationTracker
+{
+   #if TUNING_MIDDLEWARE_TRACK_ALLOCATIONS
+    // Marks the calling thread as real-time for the lifetime of this object
+    struct ScopedRealtimeSection
+    {
+        ScopedRealtimeSection();
+        ~ScopedRealtimeSection();
+
+        JUCE_DECLARE_NON_COPYABLE(ScopedRealtimeSection)
+    };
+
+    // Total allocations made inside real-time sections since startup
+    int getNumRealtimeAllocations();
+   #else
+    struct ScopedRealtimeSection
+    {
+        ScopedRealtimeSection() = default;
+    };
+
+    inline int getNumRealtimeAllocations() { return 0; }
+   #endif
+}
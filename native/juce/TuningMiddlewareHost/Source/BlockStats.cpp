@@ -0,0 +1,83 @@
+#include "BlockStats.h"
+
+namespace BlockStats
+{
+   #if TUNING_MIDDLEWARE_BLOCK_STATS
+    Summary Histogram::getSummary() const
+    {
+        Summary summary;
+
+        auto total = count.load(std::memory_order_relaxed);
+        if (total == 0)
+            return summary;
+
+        summary.count = (juce::int64) total;
+        summary.min = (double) minimum.load(std::memory_order_relaxed);
+        summary.max = (double) maximum.load(std::memory_order_relaxed);
+        summary.average = (double) sum.load(std::memory_order_relaxed) / (double) total;
+
+        // The bucket holding the 99th percentile, reported at its upper edge
+        auto rank = total - total / 100;
+        juce::uint64 seen = 0;
+
+        for (int bucket = 0; bucket < numBuckets; ++bucket)
+        {
+            seen += buckets[(size_t) bucket].load(std::memory_order_relaxed);
+
+            if (seen >= rank)
+            {
+                summary.p99 = juce::jmin((double) getBucketUpperBound(bucket), summary.max);
+                break;
+            }
+        }
+
+        return summary;
+    }
+
+    void Histogram::reset() noexcept
+    {
+        for (auto& bucket : buckets)
+            bucket.store(0, std::memory_order_relaxed);
+
+        count.store(0, std::memory_order_relaxed);
+        sum.store(0, std::memory_order_relaxed);
+        minimum.store(std::numeric_limits<juce::uint64>::max(), std::memory_order_relaxed);
+        maximum.store(0, std::memory_order_relaxed);
+    }
+
+    juce::uint64 Histogram::getBucketUpperBound(int bucket) noexcept
+    {
+        if (bucket < (1 << subBucketBits))
+            return (juce::uint64) bucket;
+
+        auto octave = (bucket >> subBucketBits) + subBucketBits - 1;
+        auto subBucket = (juce::uint64) (bucket & ((1 << subBucketBits) - 1));
+        auto width = (juce::uint64) 1 << (octave - subBucketBits);
+
+        // Written so the top bucket ends at the largest uint64 without overflowing
+        return (((juce::uint64) 1 << subBucketBits) + subBucket) * width + (width - 1);
+    }
+   #endif
+
+    void AudioCallback::prepare(double sampleRate) noexcept
+    {
+        engineTicks.reset();
+        hostedTicks.reset();
+        loadBasisPoints.reset();
+        inputEvents.reset();
+        outputEvents.reset();
+        hostedBlocksSkipped.reset();
+
+        // ticks / (numSamples / sampleRate seconds), in hundredths of a percent
+        basisPointsPerTickSample = 10000.0 * sampleRate / (double) juce::Time::getHighResolutionTicksPerSecond();
+    }
+
+    Summary AudioCallback::scale(Summary summary, double factor) noexcept
+    {
+        summary.min *= factor;
+        summary.average *= factor;
+        summary.max *= factor;
+        summary.p99 *= factor;
+        return summary;
+    }
+}
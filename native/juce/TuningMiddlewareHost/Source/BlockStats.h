@@ -0,0 +1,191 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <atomic>
+#include <limits>
+
+/**
+ * BlockStats - Lock-free measurements of the audio callback
+ *
+ * The audio thread records what each block cost and carried; any other thread
+ * can summarise it at any time. Nothing locks or allocates: with one writer a
+ * record is a few relaxed loads and stores, and percentiles are read from
+ * log-spaced buckets, four per octave, so p99 is good to about 19%.
+ *
+ * Enabled by default. With TUNING_MIDDLEWARE_BLOCK_STATS=0 every call below is
+ * an empty inline function and the callback pays nothing.
+ */
+#ifndef TUNING_MIDDLEWARE_BLOCK_STATS
+ #define TUNING_MIDDLEWARE_BLOCK_STATS 1
+#endif
+
+namespace BlockStats
+{
+    constexpr bool enabled = TUNING_MIDDLEWARE_BLOCK_STATS != 0;
+
+    struct Summary
+    {
+        juce::int64 count = 0;
+        double min = 0.0;
+        double average = 0.0;
+        double max = 0.0;
+        double p99 = 0.0;
+    };
+
+   #if TUNING_MIDDLEWARE_BLOCK_STATS
+    // Recorded by one thread only. A summary taken mid-record may be a value out.
+    class Histogram
+    {
+    public:
+        void record(juce::uint64 value) noexcept
+        {
+            increment(buckets[(size_t) getBucket(value)], 1);
+            increment(count, 1);
+            increment(sum, value);
+
+            if (value < minimum.load(std::memory_order_relaxed))
+                minimum.store(value, std::memory_order_relaxed);
+
+            if (value > maximum.load(std::memory_order_relaxed))
+                maximum.store(value, std::memory_order_relaxed);
+        }
+
+        Summary getSummary() const;
+
+        // Only while nothing is recording, e.g. from prepareToPlay()
+        void reset() noexcept;
+
+    private:
+        static constexpr int subBucketBits = 2;
+        static constexpr int numBuckets = (64 - subBucketBits + 1) << subBucketBits;
+
+        // The single writer needs no read-modify-write instruction
+        static void increment(std::atomic<juce::uint64>& counter, juce::uint64 amount) noexcept
+        {
+            counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+        }
+
+        // Values below 4 get a bucket each; above, each octave splits into four
+        static int getBucket(juce::uint64 value) noexcept
+        {
+            if (value < (1u << subBucketBits))
+                return (int) value;
+
+            auto high = (juce::uint32) (value >> 32);
+            auto octave = high != 0 ? 32 + juce::findHighestSetBit(high)
+                                    : juce::findHighestSetBit((juce::uint32) value);
+            auto subBucket = (int) (value >> (octave - subBucketBits)) & ((1 << subBucketBits) - 1);
+            return ((octave - subBucketBits + 1) << subBucketBits) + subBucket;
+        }
+
+        static juce::uint64 getBucketUpperBound(int bucket) noexcept;
+
+        std::array<std::atomic<juce::uint64>, numBuckets> buckets {};
+        std::atomic<juce::uint64> count { 0 };
+        std::atomic<juce::uint64> sum { 0 };
+        std::atomic<juce::uint64> minimum { std::numeric_limits<juce::uint64>::max() };
+        std::atomic<juce::uint64> maximum { 0 };
+    };
+
+    // A running total with one writer
+    class Counter
+    {
+    public:
+        void add(juce::int64 amount = 1) noexcept
+        {
+            value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+        }
+
+        juce::int64 get() const noexcept { return value.load(std::memory_order_relaxed); }
+        void reset() noexcept { value.store(0, std::memory_order_relaxed); }
+
+    private:
+        std::atomic<juce::int64> value { 0 };
+    };
+
+    // Elapsed high-resolution ticks since construction
+    class Stopwatch
+    {
+    public:
+        juce::int64 getElapsedTicks() const noexcept { return juce::Time::getHighResolutionTicks() - start; }
+
+    private:
+        juce::int64 start = juce::Time::getHighResolutionTicks();
+    };
+   #else
+    class Histogram
+    {
+    public:
+        void record(juce::uint64) noexcept {}
+        Summary getSummary() const { return {}; }
+        void reset() noexcept {}
+    };
+
+    class Counter
+    {
+    public:
+        void add(juce::int64 = 1) noexcept {}
+        juce::int64 get() const noexcept { return 0; }
+        void reset() noexcept {}
+    };
+
+    class Stopwatch
+    {
+    public:
+        juce::int64 getElapsedTicks() const noexcept { return 0; }
+    };
+   #endif
+
+    /**
+     * What a processor's callback spends, per block: the tuning engine's time and
+     * event counts, the hosted plugin's time where there is one, and the pair's
+     * load as a share of the block's real-time duration.
+     */
+    class AudioCallback
+    {
+    public:
+        // Resets everything; only while the callback isn't running
+        void prepare(double sampleRate) noexcept;
+
+        void recordEngine(juce::int64 ticks, int eventsIn, int eventsOut) noexcept
+        {
+            engineTicks.record((juce::uint64) ticks);
+            inputEvents.record((juce::uint64) eventsIn);
+            outputEvents.record((juce::uint64) eventsOut);
+        }
+
+        void recordHosted(juce::int64 ticks) noexcept { hostedTicks.record((juce::uint64) ticks); }
+
+        // A block the hosted plugin couldn't be given, so it played nothing
+        void recordHostedSkipped() noexcept { hostedBlocksSkipped.add(); }
+
+        // Everything the callback did during a block of numSamples
+        void recordLoad(juce::int64 ticks, int numSamples) noexcept
+        {
+            if (numSamples > 0)
+                loadBasisPoints.record((juce::uint64) ((double) ticks * basisPointsPerTickSample / numSamples));
+        }
+
+        // In microseconds
+        Summary getEngineTime() const { return scale(engineTicks.getSummary(), microsecondsPerTick); }
+        Summary getHostedTime() const { return scale(hostedTicks.getSummary(), microsecondsPerTick); }
+
+        // In percent of the block's duration
+        Summary getLoad() const { return scale(loadBasisPoints.getSummary(), 0.01); }
+
+        Summary getEventsIn() const { return inputEvents.getSummary(); }
+        Summary getEventsOut() const { return outputEvents.getSummary(); }
+
+        juce::int64 getHostedBlocksSkipped() const { return hostedBlocksSkipped.get(); }
+
+    private:
+        static Summary scale(Summary summary, double factor) noexcept;
+
+        Histogram engineTicks, hostedTicks, loadBasisPoints, inputEvents, outputEvents;
+        Counter hostedBlocksSkipped;
+
+        double microsecondsPerTick = 1.0e6 / (double) juce::Time::getHighResolutionTicksPerSecond();
+        double basisPointsPerTickSample = 0.0;
+    };
+}
@@ -0,0 +1,164 @@
+#include "EventBatcher.h"
+
+EventBatcher::EventBatcher()
+{
+}
+
+EventBatcher::~EventBatcher()
+{
+    stopTimer();
+}
+
+void EventBatcher::setFlushCallback(FlushCallback callback)
+{
+    const juce::ScopedLock sl(lock);
+    flushCallback = std::move(callback);
+}
+
+void EventBatcher::setMaxRate(int flushesPerSecond)
+{
+    maxRate.store(juce::jlimit(1, 240, flushesPerSecond));
+    restartTimer(true);
+}
+
+void EventBatcher::setMaxQueueDepth(int numEvents)
+{
+    const juce::ScopedLock sl(lock);
+    maxQueueDepth = juce::jmax(1, numEvents);
+}
+
+void EventBatcher::enqueue(const juce::var& event)
+{
+    {
+        const juce::ScopedLock sl(lock);
+
+        if (! admit())
+            return;
+
+        pending.add(PendingEvent{ {}, event });
+        metrics.maxQueueDepth = juce::jmax(metrics.maxQueueDepth, pending.size());
+    }
+
+    scheduleFlush();
+}
+
+void EventBatcher::enqueueState(const juce::String& key, const juce::var& event)
+{
+    {
+        const juce::ScopedLock sl(lock);
+
+        // Supersede an undelivered event for the same state, keeping its place
+        for (auto& item : pending)
+        {
+            if (item.stateKey == key)
+            {
+                item.event = event;
+                ++metrics.eventsCoalesced;
+                return;
+            }
+        }
+
+        if (! admit())
+            return;
+
+        pending.add(PendingEvent{ key, event });
+        metrics.maxQueueDepth = juce::jmax(metrics.maxQueueDepth, pending.size());
+    }
+
+    scheduleFlush();
+}
+
+bool EventBatcher::admit()
+{
+    if (pending.size() >= maxQueueDepth)
+    {
+        ++metrics.eventsDropped;
+        return false;
+    }
+
+    ++metrics.eventsQueued;
+    return true;
+}
+
+void EventBatcher::scheduleFlush()
+{
+    restartTimer(false);
+}
+
+void EventBatcher::restartTimer(bool onlyIfRunning)
+{
+    // Restarting a running timer applies a new rate; otherwise only an idle one starts
+    auto apply = [onlyIfRunning](EventBatcher& batcher)
+    {
+        if (batcher.isTimerRunning() == onlyIfRunning)
+            batcher.startTimerHz(batcher.maxRate.load());
+    };
+
+    // Timers may only be started from the message thread
+    if (juce::MessageManager::getInstance()->isThisTheMessageThread())
+    {
+        apply(*this);
+    }
+    else
+    {
+        juce::MessageManager::callAsync([safeThis = juce::WeakReference<EventBatcher>(this), apply]
+        {
+            if (auto* batcher = safeThis.get())
+                apply(*batcher);
+        });
+    }
+}
+
+void EventBatcher::timerCallback()
+{
+    flush();
+}
+
+void EventBatcher::flush()
+{
+    juce::Array<PendingEvent> batch;
+    FlushCallback callback;
+
+    {
+        const juce::ScopedLock sl(lock);
+        batch.swapWith(pending);
+        callback = flushCallback;
+    }
+
+    if (batch.isEmpty())
+    {
+        // Nothing arrived during the last frame, so go idle until the next event
+        stopTimer();
+        return;
+    }
+
+    if (! callback)
+        return;
+
+    juce::String json("[");
+
+    for (int i = 0; i < batch.size(); ++i)
+    {
+        if (i > 0)
+            json << ",";
+
+        json << juce::JSON::toString(batch.getReference(i).event, true);
+    }
+
+    json << "]";
+
+    {
+        const juce::ScopedLock sl(lock);
+        ++metrics.flushes;
+    }
+
+    callback(json);
+}
+
+EventBatcher::Metrics EventBatcher::getMetrics() const
+{
+    const juce::ScopedLock sl(lock);
+    auto result = metrics;
+    result.queueDepth = pending.size();
+    return result;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+/**
+ * EventBatcher - Coalesces native-to-WebView events into one delivery per frame
+ *
+ * Ordinary events are delivered in order. State events carry a key, and a newer
+ * state event replaces an undelivered one with the same key, so the UI only ever
+ * sees the latest "active voices" or "tuning" snapshot.
+ */
+class EventBatcher : private juce::Timer
+{
+public:
+    // Receives a JSON array holding every event of the batch
+    using FlushCallback = std::function<void(const juce::String& eventsJson)>;
+
+    struct Metrics
+    {
+        int queueDepth = 0;
+        int maxQueueDepth = 0;
+        juce::int64 eventsQueued = 0;
+        juce::int64 eventsCoalesced = 0;
+        juce::int64 eventsDropped = 0;
+        juce::int64 flushes = 0;
+    };
+
+    EventBatcher();
+    ~EventBatcher() override;
+
+    void setFlushCallback(FlushCallback callback);
+
+    // Upper bound on flushes per second (and so on script evaluations). Callable
+    // from any thread; a running timer picks up the new rate on the message thread.
+    void setMaxRate(int flushesPerSecond);
+    int getMaxRate() const { return maxRate.load(); }
+
+    // Events arriving while this many are pending are dropped and counted
+    void setMaxQueueDepth(int numEvents);
+
+    void enqueue(const juce::var& event);
+    void enqueueState(const juce::String& key, const juce::var& event);
+
+    // Deliver everything pending right now
+    void flush();
+
+    Metrics getMetrics() const;
+
+private:
+    void timerCallback() override;
+    bool admit();
+    void scheduleFlush();
+    void restartTimer(bool onlyIfRunning);
+
+    struct PendingEvent
+    {
+        juce::String stateKey;  // empty for ordinary events
+        juce::var event;
+    };
+
+    juce::CriticalSection lock;
+    FlushCallback flushCallback;
+    juce::Array<PendingEvent> pending;
+    Metrics metrics;
+
+    // Read by the timer without the lock
+    std::atomic<int> maxRate { 60 };
+    int maxQueueDepth = 1024;
+
+    JUCE_DECLARE_WEAK_REFERENCEABLE(EventBatcher)
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(EventBatcher)
+};
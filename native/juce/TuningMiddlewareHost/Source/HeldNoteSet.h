@@ -0,0 +1,113 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+
+/**
+ * HeldNoteSet - The notes sounding right now, kept up to date incrementally
+ *
+ * A compact list holds one entry per held note with the pitch it was given, so
+ * a retuning strategy can walk the current chord without touching the other
+ * 16 x 128 possible keys. A slot table makes add and remove O(1), and a key
+ * bitset answers "is this key held on any channel" in one load.
+ * Allocation-free; owned by the audio thread.
+ */
+class HeldNoteSet
+{
+public:
+    static constexpr int capacity = 128;
+
+    struct Note
+    {
+        juce::uint8 channel = 0;    // input channel, 0-indexed
+        juce::uint8 note = 0;       // input key
+        double pitch = 0.0;         // fractional MIDI note number actually played
+    };
+
+    HeldNoteSet()
+    {
+        for (auto& channel : slots)
+            channel.fill(-1);
+
+        keyCounts.fill(0);
+        keyBits.fill(0);
+    }
+
+    // Adds the note, replacing an entry with the same channel and key
+    void add(int channel, int note, double pitch) noexcept
+    {
+        auto& slot = slots[(size_t) channel][(size_t) note];
+
+        if (slot < 0)
+        {
+            if (numNotes == capacity)
+                return;
+
+            slot = static_cast<juce::int8>(numNotes++);
+            addKey(note);
+        }
+
+        notes[(size_t) slot] = { static_cast<juce::uint8>(channel), static_cast<juce::uint8>(note), pitch };
+    }
+
+    void remove(int channel, int note) noexcept
+    {
+        auto& slot = slots[(size_t) channel][(size_t) note];
+
+        if (slot < 0)
+            return;
+
+        // Keep the list dense by moving the last entry into the gap
+        auto last = notes[(size_t) --numNotes];
+        notes[(size_t) slot] = last;
+        slots[last.channel][last.note] = slot;
+        slot = -1;
+
+        removeKey(note);
+    }
+
+    // Visits held notes only; every other slot and count is already clear
+    void clear() noexcept
+    {
+        for (const auto& held : *this)
+        {
+            slots[held.channel][held.note] = -1;
+            keyCounts[held.note] = 0;
+        }
+
+        keyBits.fill(0);
+        numNotes = 0;
+    }
+
+    int size() const noexcept { return numNotes; }
+    bool isEmpty() const noexcept { return numNotes == 0; }
+
+    const Note* begin() const noexcept { return notes.data(); }
+    const Note* end() const noexcept { return notes.data() + numNotes; }
+    const Note& operator[](int index) const noexcept { return notes[(size_t) index]; }
+
+    bool isKeyHeld(int note) const noexcept
+    {
+        return ((keyBits[(size_t) (note >> 6)] >> (note & 63)) & 1) != 0;
+    }
+
+private:
+    void addKey(int note) noexcept
+    {
+        if (keyCounts[(size_t) note]++ == 0)
+            keyBits[(size_t) (note >> 6)] |= juce::uint64 (1) << (note & 63);
+    }
+
+    void removeKey(int note) noexcept
+    {
+        if (--keyCounts[(size_t) note] == 0)
+            keyBits[(size_t) (note >> 6)] &= ~(juce::uint64 (1) << (note & 63));
+    }
+
+    std::array<Note, capacity> notes;
+    int numNotes = 0;
+
+    std::array<std::array<juce::int8, 128>, 16> slots;  // index into notes, -1 if not held
+    std::array<juce::uint8, 128> keyCounts;             // channels holding each key
+    std::array<juce::uint64, 2> keyBits;                // keys with a non-zero count
+};
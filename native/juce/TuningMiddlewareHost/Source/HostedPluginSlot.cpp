@@ -0,0 +1,68 @@
+#include "HostedPluginSlot.h"
+
+HostedPluginSlot::HostedPluginSlot()
+{
+    startTimerHz(10);
+}
+
+HostedPluginSlot::~HostedPluginSlot()
+{
+    stopTimer();
+
+    auto* next = pending.exchange(nullptr);
+    if (next != unloadMarker())
+        delete next;
+
+    delete retired.exchange(nullptr);
+    delete active;
+}
+
+juce::AudioPluginInstance* HostedPluginSlot::unloadMarker()
+{
+    static char marker;
+    return reinterpret_cast<juce::AudioPluginInstance*>(&marker);
+}
+
+void HostedPluginSlot::setPlugin(std::unique_ptr<juce::AudioPluginInstance> newPlugin)
+{
+    JUCE_ASSERT_MESSAGE_THREAD
+
+    latest = newPlugin.get();
+
+    auto* next = newPlugin != nullptr ? newPlugin.release() : unloadMarker();
+    auto* superseded = pending.exchange(next, std::memory_order_acq_rel);
+
+    // The audio thread never saw this one, so it can go right away
+    if (superseded != unloadMarker())
+        delete superseded;
+}
+
+juce::AudioPluginInstance* HostedPluginSlot::acquire()
+{
+    // Swap only once the previous instance has been collected, so at most one is parked
+    if (pending.load(std::memory_order_relaxed) != nullptr
+        && retired.load(std::memory_order_acquire) == nullptr)
+    {
+        auto* next = pending.exchange(nullptr, std::memory_order_acq_rel);
+
+        if (next != nullptr)
+        {
+            retired.store(active, std::memory_order_release);
+            active = next != unloadMarker() ? next : nullptr;
+        }
+    }
+
+    return active;
+}
+
+void HostedPluginSlot::adoptWhileStopped()
+{
+    delete retired.exchange(nullptr, std::memory_order_acq_rel);
+    acquire();
+    delete retired.exchange(nullptr, std::memory_order_acq_rel);
+}
+
+void HostedPluginSlot::timerCallback()
+{
+    delete retired.exchange(nullptr, std::memory_order_acq_rel);
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+
+/**
+ * HostedPluginSlot - Hands a hosted plugin instance to the audio thread
+ *
+ * The message thread creates and prepares an instance, then publishes it here.
+ * The audio thread adopts it with one atomic exchange at the start of a block and
+ * parks the instance it replaces; a timer deletes parked instances later, so
+ * nothing is created or destroyed on the audio thread.
+ */
+class HostedPluginSlot : private juce::Timer
+{
+public:
+    HostedPluginSlot();
+    ~HostedPluginSlot() override;
+
+    // Message thread: publish a prepared instance, or nullptr to unload
+    void setPlugin(std::unique_ptr<juce::AudioPluginInstance> newPlugin);
+
+    // Message thread: the instance most recently set (may not be playing yet)
+    juce::AudioPluginInstance* getPlugin() const { return latest; }
+
+    // Audio thread, once per block: the instance to process, or nullptr
+    juce::AudioPluginInstance* acquire();
+
+    // Only while processBlock can't run (prepareToPlay/releaseResources):
+    // adopts any pending instance immediately and frees what it replaces.
+    void adoptWhileStopped();
+
+private:
+    void timerCallback() override;
+
+    // Distinguishes a pending unload from "nothing pending"; never dereferenced
+    static juce::AudioPluginInstance* unloadMarker();
+
+    std::atomic<juce::AudioPluginInstance*> pending { nullptr };
+    std::atomic<juce::AudioPluginInstance*> retired { nullptr };
+
+    juce::AudioPluginInstance* active = nullptr;    // audio thread
+    juce::AudioPluginInstance* latest = nullptr;    // message thread
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(HostedPluginSlot)
+};
@@ -0,0 +1,828 @@
+#include "MidiCapture.h"
+#include "StateFormat.h"
+#include "UmpBuffer.h"
+#include <utility>
+
+namespace MidiCapture
+{
+namespace
+{
+    constexpr int fifoBytes = 1 << 20;
+    constexpr int scratchBytes = 1 << 16;
+
+    // serial u32, start preset u8, samples u32, payload size u32, shared table u8.
+    // The events come next, then the table when that byte is sharedTableQueued.
+    constexpr int queuedHeaderBytes = 14;
+    constexpr int sharedTableBytes = 128 * (int) sizeof(float);
+
+    enum : juce::uint8 { sharedTableUnchanged, sharedTableQueued, sharedTableLeft };
+
+    constexpr int maxVarintBytes = 5;
+
+    // Seven bits per byte, low first; the top bit says another byte follows
+    int writeVarint(juce::uint8* dest, juce::uint32 value) noexcept
+    {
+        int numBytes = 0;
+
+        while (value >= 0x80)
+        {
+            dest[numBytes++] = (juce::uint8) (value | 0x80);
+            value >>= 7;
+        }
+
+        dest[numBytes++] = (juce::uint8) value;
+        return numBytes;
+    }
+
+    void writeVarint(juce::OutputStream& stream, juce::uint32 value)
+    {
+        juce::uint8 bytes[maxVarintBytes];
+        stream.write(bytes, (size_t) writeVarint(bytes, value));
+    }
+
+    // Bounds-checked reads over a loaded file; running out reports failure once
+    struct Cursor
+    {
+        const juce::uint8* data = nullptr;
+        size_t size = 0;
+        size_t position = 0;
+
+        bool hasBytes(size_t numBytes) const { return numBytes <= size - position; }
+
+        bool readVarint(juce::uint32& value)
+        {
+            value = 0;
+
+            for (int shift = 0; shift < 7 * maxVarintBytes; shift += 7)
+            {
+                if (! hasBytes(1))
+                    return false;
+
+                auto byte = data[position++];
+                value |= (juce::uint32) (byte & 0x7f) << shift;
+
+                if ((byte & 0x80) == 0)
+                    return true;
+            }
+
+            return false;
+        }
+
+        bool read(juce::uint8& value)
+        {
+            if (! hasBytes(1))
+                return false;
+
+            value = data[position++];
+            return true;
+        }
+
+        bool read(juce::uint16& value)
+        {
+            if (! hasBytes(2))
+                return false;
+
+            value = juce::ByteOrder::littleEndianShort(data + position);
+            position += 2;
+            return true;
+        }
+
+        bool read(juce::uint32& value)
+        {
+            if (! hasBytes(4))
+                return false;
+
+            value = juce::ByteOrder::littleEndianInt(data + position);
+            position += 4;
+            return true;
+        }
+
+        bool read(float& value)
+        {
+            juce::uint32 bits = 0;
+
+            if (! read(bits))
+                return false;
+
+            std::memcpy(&value, &bits, sizeof(value));
+            return true;
+        }
+
+        bool read(double& value)
+        {
+            if (! hasBytes(8))
+                return false;
+
+            auto bits = juce::ByteOrder::littleEndianInt64(data + position);
+            std::memcpy(&value, &bits, sizeof(value));
+            position += 8;
+            return true;
+        }
+
+        const juce::uint8* skip(size_t numBytes)
+        {
+            if (! hasBytes(numBytes))
+                return nullptr;
+
+            auto* start = data + position;
+            position += numBytes;
+            return start;
+        }
+    };
+
+    void writeFileHeader(juce::OutputStream& stream, juce::uint32 magic)
+    {
+        stream.writeInt((int) magic);
+        stream.writeShort((short) version);
+        stream.writeShort(0);
+    }
+
+    bool readFileHeader(Cursor& cursor, juce::uint32 magic)
+    {
+        juce::uint32 fileMagic = 0;
+        juce::uint16 fileVersion = 0, reserved = 0;
+
+        return cursor.read(fileMagic) && fileMagic == magic
+            && cursor.read(fileVersion) && fileVersion <= version
+            && cursor.read(reserved);
+    }
+
+    // The FIFO's free space may wrap around the end of its storage
+    void writeToFifo(juce::AbstractFifo& fifo, juce::uint8* storage, const juce::uint8* data, int numBytes) noexcept
+    {
+        const auto scope = fifo.write(numBytes);
+
+        if (scope.blockSize1 > 0)
+            memcpy(storage + scope.startIndex1, data, (size_t) scope.blockSize1);
+
+        if (scope.blockSize2 > 0)
+            memcpy(storage + scope.startIndex2, data + scope.blockSize1, (size_t) scope.blockSize2);
+    }
+
+    void readFromFifo(juce::AbstractFifo& fifo, const juce::uint8* storage, void* dest, int numBytes) noexcept
+    {
+        auto* bytes = static_cast<juce::uint8*>(dest);
+        const auto scope = fifo.read(numBytes);
+
+        if (scope.blockSize1 > 0)
+            memcpy(bytes, storage + scope.startIndex1, (size_t) scope.blockSize1);
+
+        if (scope.blockSize2 > 0)
+            memcpy(bytes + scope.blockSize1, storage + scope.startIndex2, (size_t) scope.blockSize2);
+    }
+}
+
+//==============================================================================
+Recorder::Recorder(TuningEngine& e)
+    : juce::Thread("MIDI capture writer"),
+      engine(e)
+{
+}
+
+Recorder::~Recorder()
+{
+    stop();
+}
+
+bool Recorder::start(const juce::File& captureFile, double sampleRate, int blockSize, bool midi2Destination, juce::String& error)
+{
+    stop();
+
+    auto output = std::make_unique<juce::FileOutputStream>(captureFile);
+
+    if (output->failedToOpen())
+    {
+        error = output->getStatus().getErrorMessage();
+        return false;
+    }
+
+    output->setPosition(0);
+    output->truncate();
+
+    writeFileHeader(*output, captureMagic);
+    output->writeDouble(sampleRate);
+    output->writeInt(blockSize);
+    output->writeInt(engine.getMaxEventsPerBlock());
+    output->writeByte(midi2Destination ? 1 : 0);
+
+    // Kept from the first capture on: the audio thread and the listener may only
+    // ever see valid storage
+    if (fifoStorage == nullptr)
+    {
+        fifoStorage.calloc((size_t) fifoBytes);
+        scratch.calloc((size_t) scratchBytes);
+        pendingSnapshots = std::make_unique<PendingSnapshot[]>((size_t) maxPendingSnapshots);
+    }
+
+    fifo.setTotalSize(fifoBytes);
+    overflowed = false;
+    numBlocks = 0;
+    snapshotMissing = false;
+    queuedSharedTable = false;
+    hasWrittenSnapshot = false;
+    writtenPreset = -1;
+    playedSerial = 0;
+    lastSnapshot = nullptr;
+    bytesWritten = output->getPosition();
+    stream = std::move(output);
+    file = captureFile;
+
+    // The first snapshot is taken as the listener is added, under the engine's lock
+    engine.addStateListener(this, true);
+
+    // Written ahead of the first block, so every block has a state at or before
+    // its own to restore; no recorded block can play an older one. Edits made
+    // meanwhile replace the slot, so the newest is taken.
+    for (;;)
+    {
+        PendingSnapshot* newest = nullptr;
+
+        for (int i = 0; i < maxPendingSnapshots; ++i)
+        {
+            auto& slot = pendingSnapshots[i];
+
+            if (slot.state.load(std::memory_order_acquire) == PendingSnapshot::ready
+                && (newest == nullptr || slot.engineState.serial > newest->engineState.serial))
+                newest = &slot;
+        }
+
+        int expected = PendingSnapshot::ready;
+
+        if (newest != nullptr && newest->state.compare_exchange_strong(expected, PendingSnapshot::claimed))
+        {
+            writeSnapshot(*newest);
+            break;
+        }
+
+        juce::Thread::yield();
+    }
+
+    startThread();
+    recording = true;
+    return true;
+}
+
+Recorder::Status Recorder::stop()
+{
+    if (stream != nullptr)
+    {
+        // Detaches the audio thread. It checks the flag again once it has said it
+        // is inside, so either it sees this or we see it inside; a block in flight
+        // is still writing to the FIFO, so it is waited for however long it takes.
+        recording = false;
+
+        while (isInsideBlock())
+            juce::Thread::yield();
+
+        engine.removeStateListener(this);
+        signalThreadShouldExit();
+        notify();
+        stopThread(2000);
+
+        drain();
+        stream->flush();
+        stream.reset();
+
+        // The listener is gone, so the slots are the writer's alone
+        for (int i = 0; i < maxPendingSnapshots; ++i)
+        {
+            pendingSnapshots[i].engineState.retuningStrategy = nullptr;
+            pendingSnapshots[i].state = PendingSnapshot::free;
+        }
+    }
+
+    return getStatus();
+}
+
+Recorder::Status Recorder::getStatus() const
+{
+    Status status;
+    status.recording = recording;
+    status.overflowed = overflowed;
+    status.blocks = numBlocks;
+    status.bytesWritten = bytesWritten;
+    status.file = file;
+    return status;
+}
+
+void Recorder::beginBlock(const juce::MidiBuffer& input, int numSamples) noexcept
+{
+    if (! recording.load(std::memory_order_acquire))
+        return;
+
+    blockEpoch.fetch_add(1);
+
+    if (! recording)
+    {
+        blockEpoch.fetch_add(1);
+        return;
+    }
+
+    // Encoded here, before the engine edits the buffer in place. The header in
+    // front is filled in once the block has been played.
+    auto* dest = scratch.get();
+    int used = queuedHeaderBytes;
+    used += writeVarint(dest + used, (juce::uint32) input.getNumEvents());
+    int previousPosition = 0;
+
+    for (const auto metadata : input)
+    {
+        if (used + 2 * maxVarintBytes + metadata.numBytes > scratchBytes - sharedTableBytes)
+        {
+            overflowed = true;
+            recording = false;
+            blockEpoch.fetch_add(1);
+            return;
+        }
+
+        used += writeVarint(dest + used, (juce::uint32) (metadata.samplePosition - previousPosition));
+        used += writeVarint(dest + used, (juce::uint32) metadata.numBytes);
+        memcpy(dest + used, metadata.data, (size_t) metadata.numBytes);
+        used += metadata.numBytes;
+        previousPosition = metadata.samplePosition;
+    }
+
+    scratchUsed = used;
+    pendingSamples = numSamples;
+    blockPending = true;
+}
+
+void Recorder::endBlock() noexcept
+{
+    if (! blockPending)
+        return;
+
+    blockPending = false;
+
+    auto serial = engine.getBlockStateSerial();
+    auto* header = scratch.get();
+    juce::writeUnaligned<juce::uint32>(header, serial);
+    header[4] = (juce::uint8) engine.getBlockStartPreset();
+    juce::writeUnaligned<juce::uint32>(header + 5, (juce::uint32) pendingSamples);
+    juce::writeUnaligned<juce::uint32>(header + 9, (juce::uint32) (scratchUsed - queuedHeaderBytes));
+    header[13] = sharedTableUnchanged;
+
+    // A group's table isn't part of the engine's state, so it goes with the first
+    // block that plays each one, and the first that plays the presets again
+    auto* sharedTable = engine.getBlockSharedTable();
+    auto sharedTableSerial = engine.getBlockSharedTableSerial();
+
+    if (sharedTable != nullptr && (! queuedSharedTable || sharedTableSerial != queuedSharedTableSerial))
+    {
+        // beginBlock() left room for it
+        memcpy(scratch.get() + scratchUsed, sharedTable->data(), (size_t) sharedTableBytes);
+        scratchUsed += sharedTableBytes;
+        header[13] = sharedTableQueued;
+    }
+    else if (sharedTable == nullptr && queuedSharedTable)
+    {
+        header[13] = sharedTableLeft;
+    }
+
+    if (fifo.getFreeSpace() < scratchUsed)
+    {
+        // A gap would make the rest unreplayable, so the capture ends here
+        overflowed = true;
+        recording = false;
+    }
+    else
+    {
+        // One write, so the writer thread never sees a header without its events
+        writeToFifo(fifo, fifoStorage.get(), scratch.get(), scratchUsed);
+        numBlocks.store(numBlocks.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+        queuedSharedTable = sharedTable != nullptr;
+        queuedSharedTableSerial = sharedTableSerial;
+    }
+
+    playedSerial = serial;
+    blockEpoch.fetch_add(1);
+}
+
+void Recorder::run()
+{
+    while (! threadShouldExit())
+    {
+        drain();
+        wait(20);
+    }
+}
+
+void Recorder::tuningStatePublished(const TuningEngine::SavedState& state)
+{
+    // The engine's writer lock is held, so this is one copy into a slot and no
+    // allocation or lock. Read after the edit was published: a block that began
+    // later bumps it, and one that ended earlier has stored what it played.
+    auto epoch = blockEpoch.load();
+
+    // The last edit's slot is reused when no block can have played it: none was
+    // in flight or has begun since, and the last to end played an older state.
+    // Edits between two blocks so take one slot, however many there are.
+    if (lastSnapshot != nullptr && epoch == lastSnapshotEpoch && (epoch & 1) == 0
+        && playedSerial.load() < lastSnapshot->engineState.serial)
+    {
+        int expected = PendingSnapshot::ready;
+
+        if (lastSnapshot->state.compare_exchange_strong(expected, PendingSnapshot::filling))
+        {
+            lastSnapshot->engineState = state;
+            lastSnapshot->state.store(PendingSnapshot::ready, std::memory_order_release);
+            return;
+        }
+    }
+
+    // Freed slots have had their strategy released
+    for (int i = 0; i < maxPendingSnapshots; ++i)
+    {
+        auto& slot = pendingSnapshots[i];
+
+        if (slot.state.load(std::memory_order_acquire) == PendingSnapshot::free)
+        {
+            slot.state = PendingSnapshot::filling;
+            slot.engineState = state;
+            slot.state.store(PendingSnapshot::ready, std::memory_order_release);
+            lastSnapshot = &slot;
+            lastSnapshotEpoch = epoch;
+            return;
+        }
+    }
+
+    // A block may play this edit, and without it the rest can't be replayed
+    overflowed = true;
+    recording = false;
+}
+
+void Recorder::drain()
+{
+    juce::MemoryBlock payload;
+    std::array<float, 128> sharedTable;
+
+    while (fifo.getNumReady() >= queuedHeaderBytes)
+    {
+        juce::uint8 header[queuedHeaderBytes];
+        readFromFifo(fifo, fifoStorage.get(), header, queuedHeaderBytes);
+
+        auto serial = juce::readUnaligned<juce::uint32>(header);
+        auto preset = (int) header[4];
+        auto numSamples = juce::readUnaligned<juce::uint32>(header + 5);
+        auto payloadSize = (int) juce::readUnaligned<juce::uint32>(header + 9);
+        auto sharedTableChange = header[13];
+
+        payload.setSize((size_t) payloadSize);
+        readFromFifo(fifo, fifoStorage.get(), payload.getData(), payloadSize);
+
+        if (sharedTableChange == sharedTableQueued)
+            readFromFifo(fifo, fifoStorage.get(), sharedTable.data(), sharedTableBytes);
+
+        // A block without its state would replay wrongly, and so would every one after it
+        if (snapshotMissing)
+            continue;
+
+        if ((! hasWrittenSnapshot || serial != writtenSerial) && ! writeSnapshotFor(serial))
+        {
+            snapshotMissing = true;
+            overflowed = true;
+            recording = false;
+            continue;
+        }
+
+        if (sharedTableChange != sharedTableUnchanged)
+        {
+            stream->writeByte('G');
+            stream->writeByte(sharedTableChange == sharedTableQueued ? 1 : 0);
+
+            if (sharedTableChange == sharedTableQueued)
+                for (auto cents : sharedTable)
+                    stream->writeFloat(cents);
+        }
+
+        if (preset != writtenPreset)
+        {
+            stream->writeByte('P');
+            stream->writeByte((char) preset);
+            writtenPreset = preset;
+        }
+
+        stream->writeByte('B');
+        writeVarint(*stream, numSamples);
+        stream->write(payload.getData(), payload.getSize());
+    }
+
+    bytesWritten = stream->getPosition();
+}
+
+bool Recorder::writeSnapshotFor(juce::uint32 serial)
+{
+    // Played before the starting snapshot was copied; that one still applies
+    if (hasWrittenSnapshot && serial < writtenSerial)
+        return true;
+
+    // A slot a block played is never reused, so it is here, or the listener that
+    // takes it is still copying
+    for (;;)
+    {
+        for (int i = 0; i < maxPendingSnapshots; ++i)
+        {
+            auto& slot = pendingSnapshots[i];
+            int expected = PendingSnapshot::ready;
+
+            if (slot.state.load(std::memory_order_acquire) == PendingSnapshot::ready && slot.engineState.serial == serial
+                && slot.state.compare_exchange_strong(expected, PendingSnapshot::claimed))
+            {
+                writeSnapshot(slot);
+                return true;
+            }
+        }
+
+        if (overflowed)
+            return false;
+
+        juce::Thread::yield();
+    }
+}
+
+void Recorder::writeSnapshot(PendingSnapshot& slot)
+{
+    // Serialized here, on the writer thread, from the copy the listener made
+    juce::MemoryBlock snapshot;
+
+    {
+        StateFormat::Writer writer(snapshot);
+        StateFormat::writeTuningEngine(writer, slot.engineState);
+    }
+
+    stream->writeByte('S');
+    stream->writeInt((int) snapshot.getSize());
+    stream->write(snapshot.getData(), snapshot.getSize());
+
+    hasWrittenSnapshot = true;
+    writtenSerial = slot.engineState.serial;
+
+    // The restore selects the snapshot's preset, so the block's own must follow it
+    writtenPreset = -1;
+
+    // Blocks come in serial order, so this one and any older are done with
+    for (int i = 0; i < maxPendingSnapshots; ++i)
+    {
+        auto& other = pendingSnapshots[i];
+        int expected = PendingSnapshot::ready;
+
+        if (&other == &slot
+            || (other.state.load(std::memory_order_acquire) == PendingSnapshot::ready && other.engineState.serial < writtenSerial
+                && other.state.compare_exchange_strong(expected, PendingSnapshot::claimed)))
+        {
+            other.engineState.retuningStrategy = nullptr;
+            other.state.store(PendingSnapshot::free, std::memory_order_release);
+        }
+    }
+}
+
+//==============================================================================
+bool readCapture(const juce::File& captureFile, Capture& capture, juce::String& error)
+{
+    juce::MemoryBlock contents;
+
+    if (! captureFile.loadFileAsData(contents))
+    {
+        error = "Can't read " + captureFile.getFullPathName();
+        return false;
+    }
+
+    Cursor cursor { static_cast<const juce::uint8*>(contents.getData()), contents.getSize() };
+
+    juce::uint32 blockSize = 0, maxEvents = 0;
+    juce::uint8 midi2 = 0;
+
+    if (! readFileHeader(cursor, captureMagic)
+        || ! cursor.read(capture.sampleRate) || ! cursor.read(blockSize)
+        || ! cursor.read(maxEvents) || ! cursor.read(midi2))
+    {
+        error = "Not a MIDI capture: " + captureFile.getFullPathName();
+        return false;
+    }
+
+    capture.blockSize = (int) blockSize;
+    capture.maxEventsPerBlock = (int) maxEvents;
+    capture.midi2Destination = midi2 != 0;
+    capture.snapshots.clear();
+    capture.sharedTables.clear();
+    capture.blocks.clear();
+
+    int pendingSnapshot = -1, pendingSharedTable = -1, pendingPreset = -1;
+
+    // A capture cut short, by a crash say, replays up to its last whole block
+    while (cursor.hasBytes(1))
+    {
+        juce::uint8 type = 0;
+        cursor.read(type);
+
+        if (type == 'S')
+        {
+            juce::uint32 size = 0;
+            const juce::uint8* bytes = nullptr;
+
+            if (! cursor.read(size) || (bytes = cursor.skip(size)) == nullptr)
+                break;
+
+            capture.snapshots.emplace_back(bytes, (size_t) size);
+            pendingSnapshot = (int) capture.snapshots.size() - 1;
+        }
+        else if (type == 'G')
+        {
+            juce::uint8 playsTable = 0;
+
+            if (! cursor.read(playsTable))
+                break;
+
+            if (playsTable == 0)
+            {
+                pendingSharedTable = Capture::leaveSharedTable;
+                continue;
+            }
+
+            std::array<float, 128> cents;
+            bool complete = true;
+
+            for (auto& entry : cents)
+                complete = complete && cursor.read(entry);
+
+            if (! complete)
+                break;
+
+            // A table of its own each time, as the recorded engine was given a new one
+            capture.sharedTables.push_back(new SharedTable(cents));
+            pendingSharedTable = (int) capture.sharedTables.size() - 1;
+        }
+        else if (type == 'P')
+        {
+            juce::uint8 preset = 0;
+
+            if (! cursor.read(preset))
+                break;
+
+            pendingPreset = preset;
+        }
+        else if (type == 'B')
+        {
+            Capture::Block block;
+            juce::uint32 numSamples = 0, numEvents = 0;
+
+            if (! cursor.readVarint(numSamples) || ! cursor.readVarint(numEvents))
+                break;
+
+            block.numSamples = (int) numSamples;
+
+            bool complete = true;
+            int position = 0;
+
+            for (juce::uint32 i = 0; i < numEvents && complete; ++i)
+            {
+                juce::uint32 delta = 0, size = 0;
+                const juce::uint8* bytes = nullptr;
+
+                complete = cursor.readVarint(delta) && cursor.readVarint(size) && (bytes = cursor.skip(size)) != nullptr;
+
+                if (complete)
+                {
+                    position += (int) delta;
+                    block.input.addEvent(bytes, (int) size, position);
+                }
+            }
+
+            if (! complete)
+                break;
+
+            block.snapshot = std::exchange(pendingSnapshot, -1);
+            block.sharedTable = std::exchange(pendingSharedTable, -1);
+            block.preset = std::exchange(pendingPreset, -1);
+            capture.blocks.push_back(std::move(block));
+        }
+        else
+        {
+            error = "Unknown record in MIDI capture";
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void prepareEngine(const Capture& capture, const Capture::Block& block, TuningEngine& engine)
+{
+    if (juce::isPositiveAndBelow(block.snapshot, (int) capture.snapshots.size()))
+    {
+        const auto& snapshot = capture.snapshots[(size_t) block.snapshot];
+        StateFormat::Reader reader(snapshot.getData(), snapshot.getSize());
+        StateFormat::EngineState state;
+        StateFormat::Chunk chunk;
+
+        while (reader.next(chunk))
+            StateFormat::readTuningEngineChunk(chunk, state);
+
+        if (reader.isValid())
+            StateFormat::restoreTuningEngine(state, engine);
+    }
+
+    if (block.sharedTable == Capture::leaveSharedTable)
+        engine.setSharedTable(nullptr);
+    else if (juce::isPositiveAndBelow(block.sharedTable, (int) capture.sharedTables.size()))
+        engine.setSharedTable(capture.sharedTables[(size_t) block.sharedTable]);
+
+    if (block.preset >= 0)
+        engine.selectPreset(block.preset);
+}
+
+void encodeOutput(const juce::MidiBuffer& midi, const UmpBuffer* ump, juce::MemoryOutputStream& dest)
+{
+    int previousPosition = 0;
+
+    if (ump != nullptr)
+    {
+        dest.writeByte(1);
+        writeVarint(dest, (juce::uint32) ump->getNumEvents());
+
+        for (const auto& event : *ump)
+        {
+            writeVarint(dest, (juce::uint32) (event.samplePosition - previousPosition));
+            dest.writeByte((char) event.numWords);
+
+            for (int word = 0; word < event.numWords; ++word)
+                dest.writeInt((int) event.words[(size_t) word]);
+
+            previousPosition = event.samplePosition;
+        }
+
+        return;
+    }
+
+    dest.writeByte(0);
+    writeVarint(dest, (juce::uint32) midi.getNumEvents());
+
+    for (const auto metadata : midi)
+    {
+        writeVarint(dest, (juce::uint32) (metadata.samplePosition - previousPosition));
+        writeVarint(dest, (juce::uint32) metadata.numBytes);
+        dest.write(metadata.data, (size_t) metadata.numBytes);
+        previousPosition = metadata.samplePosition;
+    }
+}
+
+bool writeGolden(const juce::File& goldenFile, const std::vector<juce::MemoryBlock>& blocks, juce::String& error)
+{
+    juce::MemoryOutputStream contents;
+    writeFileHeader(contents, goldenMagic);
+    contents.writeInt((int) blocks.size());
+
+    for (const auto& block : blocks)
+    {
+        writeVarint(contents, (juce::uint32) block.getSize());
+        contents.write(block.getData(), block.getSize());
+    }
+
+    if (! goldenFile.replaceWithData(contents.getData(), contents.getDataSize()))
+    {
+        error = "Can't write " + goldenFile.getFullPathName();
+        return false;
+    }
+
+    return true;
+}
+
+bool readGolden(const juce::File& goldenFile, std::vector<juce::MemoryBlock>& blocks, juce::String& error)
+{
+    juce::MemoryBlock contents;
+
+    if (! goldenFile.loadFileAsData(contents))
+    {
+        error = "Can't read " + goldenFile.getFullPathName();
+        return false;
+    }
+
+    Cursor cursor { static_cast<const juce::uint8*>(contents.getData()), contents.getSize() };
+    juce::uint32 numBlocks = 0;
+
+    if (! readFileHeader(cursor, goldenMagic) || ! cursor.read(numBlocks))
+    {
+        error = "Not a golden output file: " + goldenFile.getFullPathName();
+        return false;
+    }
+
+    blocks.clear();
+
+    for (juce::uint32 i = 0; i < numBlocks; ++i)
+    {
+        juce::uint32 size = 0;
+        const juce::uint8* bytes = nullptr;
+
+        if (! cursor.readVarint(size) || (bytes = cursor.skip(size)) == nullptr)
+        {
+            error = "Golden output file is truncated";
+            return false;
+        }
+
+        blocks.emplace_back(bytes, (size_t) size);
+    }
+
+    return true;
+}
+}
@@ -0,0 +1,179 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+#include <vector>
+#include "TuningEngine.h"
+
+class UmpBuffer;
+
+/**
+ * MidiCapture - Records what a TuningEngine was given, so it can be replayed exactly
+ *
+ * A capture holds every input block as it arrived, together with the engine
+ * state each block was played with, so feeding it back through a fresh engine
+ * reproduces the session block for block. The replay benchmark does that at
+ * full speed and diffs the output against a golden file.
+ *
+ * Capture file (little endian):
+ *   u32 magic 'TMCP', u16 version, u16 reserved, f64 sample rate,
+ *   u32 block size, u32 max events per block, u8 MIDI 2.0 destination (0/1),
+ *   then records of a u8 type:
+ *     'S'  u32 size, a StateFormat blob of the engine (no plugin chunk). It is
+ *          restored before the next block.
+ *     'G'  u8 1 then 128 f32 cents: the shared table (a tuning group's) the
+ *          next block plays, or u8 0: it plays its presets again. Written when
+ *          that changes; version 2 on.
+ *     'P'  u8 preset the next block starts on. Only written when that changes.
+ *     'B'  varint samples, varint event count, then for each event a varint
+ *          position delta from the previous one, a varint size and the bytes.
+ *
+ * Golden file: u32 magic 'TMGD', u16 version, u16 reserved, u32 block count,
+ * then per block a varint size and the output encoded by encodeOutput().
+ */
+namespace MidiCapture
+{
+    constexpr juce::uint32 captureMagic = 0x50434d54;   // 'TMCP'
+    constexpr juce::uint32 goldenMagic = 0x44474d54;    // 'TMGD'
+    constexpr juce::uint16 version = 2;
+
+    /**
+     * Recorder - The capture side, owned by a processor next to its engine
+     *
+     * The audio thread copies each block into a lock-free FIFO and a writer thread
+     * streams it to disk. Each published edit is copied into a preallocated slot,
+     * which is all that happens under the engine's lock, and replaces the one
+     * before it when no block can have played that; the writer thread serializes
+     * the ones blocks played. If the FIFO or the slots fill up the capture ends there,
+     * since a capture with a gap can't be replayed. Start captures with no notes
+     * held: voices sounding before the first block aren't in the file.
+     */
+    class Recorder : private juce::Thread,
+                     private TuningEngine::StateListener
+    {
+    public:
+        explicit Recorder(TuningEngine& engine);
+        ~Recorder() override;
+
+        struct Status
+        {
+            bool recording = false;
+            bool overflowed = false;        // ended early because the writer thread fell behind
+            juce::int64 blocks = 0;
+            juce::int64 bytesWritten = 0;
+            juce::File file;
+        };
+
+        // Message thread. Replaces a capture in progress; false with an error when
+        // the file can't be written.
+        bool start(const juce::File& file, double sampleRate, int blockSize, bool midi2Destination, juce::String& error);
+        Status stop();
+        Status getStatus() const;
+
+        // Audio thread, either side of TuningEngine::processBlock. Both return
+        // straight away when nothing is being recorded.
+        void beginBlock(const juce::MidiBuffer& input, int numSamples) noexcept;
+        void endBlock() noexcept;
+
+    private:
+        void run() override;
+        void tuningStatePublished(const TuningEngine::SavedState& state) override;
+
+        // Writer thread: moves what the audio thread queued to the file
+        void drain();
+
+        // Writes the pending snapshot a block played, waiting for the listener if
+        // it is still copying. False when it was lost to a full set of slots.
+        bool writeSnapshotFor(juce::uint32 serial);
+
+        // Writes the slot, which the caller has claimed, and frees it and any older
+        struct PendingSnapshot;
+        void writeSnapshot(PendingSnapshot& slot);
+
+        bool isInsideBlock() const noexcept { return (blockEpoch.load() & 1) != 0; }
+
+        TuningEngine& engine;
+
+        // Audio thread -> writer thread
+        juce::HeapBlock<juce::uint8> fifoStorage, scratch;
+        juce::AbstractFifo fifo { 1 };
+        int scratchUsed = 0;
+        int pendingSamples = 0;
+        bool blockPending = false;
+        bool queuedSharedTable = false;
+        juce::uint32 queuedSharedTableSerial = 0;
+        std::atomic<bool> recording { false };
+        std::atomic<bool> overflowed { false };
+        std::atomic<juce::int64> numBlocks { 0 };
+
+        // Bumped as each recorded block begins and ends, so odd while one is in
+        // flight; the serial is stored before the second bump
+        std::atomic<juce::uint32> blockEpoch { 0 };
+        std::atomic<juce::uint32> playedSerial { 0 };
+
+        // Editing thread -> writer thread. Only the listener takes a free slot and
+        // only the writer thread frees one; either claims a ready one to reuse or
+        // write it.
+        struct PendingSnapshot
+        {
+            enum { free, filling, ready, claimed };
+
+            std::atomic<int> state { free };
+            TuningEngine::SavedState engineState;
+        };
+
+        static constexpr int maxPendingSnapshots = 32;
+        std::unique_ptr<PendingSnapshot[]> pendingSnapshots;
+
+        // Editing thread: the slot of the last edit and the epoch just after it
+        PendingSnapshot* lastSnapshot = nullptr;
+        juce::uint32 lastSnapshotEpoch = 0;
+
+        // Writer thread
+        std::unique_ptr<juce::FileOutputStream> stream;
+        bool snapshotMissing = false;
+        bool hasWrittenSnapshot = false;
+        juce::uint32 writtenSerial = 0;
+        int writtenPreset = -1;
+        std::atomic<juce::int64> bytesWritten { 0 };
+        juce::File file;
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Recorder)
+    };
+
+    // A capture read back in full, events decoded, for replaying
+    struct Capture
+    {
+        struct Block
+        {
+            int numSamples = 0;
+            juce::MidiBuffer input;
+            int snapshot = -1;    // index into snapshots to restore first, or -1
+            int sharedTable = -1; // index into sharedTables to play, leaveSharedTable or -1
+            int preset = -1;      // preset to select first, or -1
+        };
+
+        static constexpr int leaveSharedTable = -2;
+
+        double sampleRate = 44100.0;
+        int blockSize = 512;
+        int maxEventsPerBlock = 1024;
+        bool midi2Destination = false;
+
+        std::vector<juce::MemoryBlock> snapshots;
+        std::vector<SharedTable::Ptr> sharedTables;
+        std::vector<Block> blocks;
+    };
+
+    bool readCapture(const juce::File& file, Capture& capture, juce::String& error);
+
+    // Restores the block's snapshot, shared table and preset, if it has them, ahead of processBlock
+    void prepareEngine(const Capture& capture, const Capture::Block& block, TuningEngine& engine);
+
+    // One block of engine output as compact bytes: the MIDI 1.0 events, or the
+    // packets when ump is non-null. Equal output encodes to equal bytes.
+    void encodeOutput(const juce::MidiBuffer& midi, const UmpBuffer* ump, juce::MemoryOutputStream& dest);
+
+    bool writeGolden(const juce::File& file, const std::vector<juce::MemoryBlock>& blocks, juce::String& error);
+    bool readGolden(const juce::File& file, std::vector<juce::MemoryBlock>& blocks, juce::String& error);
+}
@@ -0,0 +1,123 @@
+#include "MtsEspMaster.h"
+
+MtsEspMaster::MtsEspMaster(TuningEngine& e)
+    : engine(e)
+{
+    auto libraryFile = getLibraryFile();
+
+    if (! libraryFile.existsAsFile() || ! library.open(libraryFile.getFullPathName()))
+        return; // MTS-ESP not installed
+
+    registerFunction       = reinterpret_cast<VoidFunction>(library.getFunction("MTS_RegisterMaster"));
+    deregisterFunction     = reinterpret_cast<VoidFunction>(library.getFunction("MTS_DeregisterMaster"));
+    hasMasterFunction      = reinterpret_cast<BoolFunction>(library.getFunction("MTS_HasMaster"));
+    getNumClientsFunction  = reinterpret_cast<IntFunction>(library.getFunction("MTS_GetNumClients"));
+    setNoteTuningsFunction = reinterpret_cast<TuningFunction>(library.getFunction("MTS_SetNoteTunings"));
+
+    registerMaster();
+}
+
+MtsEspMaster::~MtsEspMaster()
+{
+    engine.removeStateListener(this);
+    stopTimer();
+
+    if (active)
+        deregisterFunction();
+}
+
+juce::File MtsEspMaster::getLibraryFile()
+{
+    // Fixed install locations defined by the MTS-ESP SDK
+   #if JUCE_WINDOWS
+    return juce::File::getSpecialLocation(juce::File::globalApplicationsDirectory)
+               .getChildFile("Common Files").getChildFile("MTS-ESP").getChildFile("LIBMTS.dll");
+   #elif JUCE_MAC
+    return juce::File("/Library/Application Support/MTS-ESP/libMTS.dylib");
+   #else
+    return juce::File("/usr/local/lib/libMTS.so");
+   #endif
+}
+
+bool MtsEspMaster::registerMaster()
+{
+    JUCE_ASSERT_MESSAGE_THREAD
+
+    if (active)
+        return true;
+
+    if (registerFunction == nullptr || deregisterFunction == nullptr || hasMasterFunction == nullptr
+        || getNumClientsFunction == nullptr || setNoteTuningsFunction == nullptr)
+        return false;
+
+    // Another instance (or app) may already own the session
+    if (hasMasterFunction())
+        return false;
+
+    registerFunction();
+    active = true;
+    hasSentTuning = false;
+
+    // Listening first, so an edit made meanwhile is sent again by the timer
+    engine.addStateListener(this);
+    sendEngineTuning();
+    startTimerHz(60);
+    return true;
+}
+
+int MtsEspMaster::getClientCount() const
+{
+    return active ? getNumClientsFunction() : 0;
+}
+
+void MtsEspMaster::setNoteTunings(const double* frequenciesHz)
+{
+    JUCE_ASSERT_MESSAGE_THREAD
+
+    // Edits made before this one are superseded by it
+    engineTuningChanged = false;
+    sendTuning(frequenciesHz);
+}
+
+void MtsEspMaster::tuningStatePublished(const TuningEngine::SavedState&)
+{
+    // Under the engine's writer lock: no library call, no copy, just a flag
+    engineTuningChanged = true;
+}
+
+void MtsEspMaster::timerCallback()
+{
+    // Edits, switches made by program change or CC on the audio thread, and
+    // edits to a tuning group's table, which aren't edits to the engine
+    if (engineTuningChanged.exchange(false) || engine.getCurrentPreset() != broadcastPreset
+        || engine.getSharedTableSerial() != broadcastSharedSerial)
+        sendEngineTuning();
+}
+
+void MtsEspMaster::sendEngineTuning()
+{
+    std::array<double, 128> frequencies;
+
+    // Read first, so a group edit made during the copy is sent on the next tick
+    broadcastSharedSerial = engine.getSharedTableSerial();
+    engine.copyState(engineState);
+    TuningEngine::getKeyFrequencies(engineState, frequencies);
+
+    broadcastPreset = engineState.selectedPreset;
+    sendTuning(frequencies.data());
+}
+
+void MtsEspMaster::sendTuning(const double* frequenciesHz)
+{
+    if (! active)
+        return;
+
+    if (hasSentTuning && std::equal(lastTuning.begin(), lastTuning.end(), frequenciesHz))
+        return;
+
+    std::copy(frequenciesHz, frequenciesHz + 128, lastTuning.begin());
+    hasSentTuning = true;
+
+    // libMTS copies the table into shared memory; clients pick it up per note
+    setNoteTuningsFunction(lastTuning.data());
+}
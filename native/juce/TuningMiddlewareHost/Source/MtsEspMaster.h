@@ -0,0 +1,78 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <atomic>
+#include "TuningEngine.h"
+
+/**
+ * MtsEspMaster - Keeps MTS-ESP clients playing what a TuningEngine plays
+ *
+ * Talks to the MTS-ESP system library (libMTS), which owns the shared memory
+ * every MTS-ESP client in the session reads its tuning from. The library is
+ * loaded at runtime, so without MTS-ESP installed this does nothing. A session
+ * has one master, so the first instance to register is it and the others stay
+ * inactive until it goes.
+ *
+ * Edits are published under the engine's writer lock, where libMTS mustn't be
+ * called, so an edit only marks the tuning as changed. A message-thread timer
+ * sends it with no lock held, once per frame at most, and also picks up preset
+ * switches made by incoming MIDI on the audio thread.
+ */
+class MtsEspMaster : private TuningEngine::StateListener,
+                     private juce::Timer
+{
+public:
+    explicit MtsEspMaster(TuningEngine& engine);
+    ~MtsEspMaster() override;
+
+    // Message thread. Registers if no other master holds the session, sending
+    // the engine's tuning straight away; true while this is the master.
+    bool registerMaster();
+    bool isActive() const { return active.load(); }
+
+    int getClientCount() const;
+
+    // Sends 128 frequencies in Hz in place of the engine's tuning, until its next edit
+    void setNoteTunings(const double* frequenciesHz);
+
+private:
+    void tuningStatePublished(const TuningEngine::SavedState& state) override;
+    void timerCallback() override;
+
+    // The engine's current tuning, skipped when clients already have it
+    void sendEngineTuning();
+    void sendTuning(const double* frequenciesHz);
+
+    static juce::File getLibraryFile();
+
+    using VoidFunction = void (*)();
+    using BoolFunction = bool (*)();
+    using IntFunction = int (*)();
+    using TuningFunction = void (*)(const double*);
+
+    TuningEngine& engine;
+
+    juce::DynamicLibrary library;
+    VoidFunction registerFunction = nullptr;
+    VoidFunction deregisterFunction = nullptr;
+    BoolFunction hasMasterFunction = nullptr;
+    IntFunction getNumClientsFunction = nullptr;
+    TuningFunction setNoteTuningsFunction = nullptr;
+
+    std::atomic<bool> active { false };
+
+    // Set by the listener, cleared by whichever send picks the edit up
+    std::atomic<bool> engineTuningChanged { false };
+
+    // Message thread
+    TuningEngine::SavedState engineState;
+    std::array<double, 128> lastTuning {};
+    bool hasSentTuning = false;
+
+    // The preset and shared table the last broadcast of the engine's tuning was made for
+    int broadcastPreset = -1;
+    juce::uint32 broadcastSharedSerial = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MtsEspMaster)
+};
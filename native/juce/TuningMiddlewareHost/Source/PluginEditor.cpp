@@ -2,23 +2,32 @@
 #include "PluginEditor.h"
 
 TuningMiddlewareHostEditor::TuningMiddlewareHostEditor(TuningMiddlewareHostProcessor& p)
-    : AudioProcessorEditor(&p), processorRef(p)
+    : AudioProcessorEditor(&p), processorRef(p),
+      reattaching(p.hasWebView()),
+      rpcBridge(p.getRpcBridge()),
+      webView(p.getWebView())
 {
-    // Create RPC bridge
-    rpcBridge = std::make_unique<RpcBridge>(processorRef);
-    
-    // Create WebView
-    webView = std::make_unique<WebViewComponent>(*rpcBridge);
-    addAndMakeVisible(*webView);
+    addAndMakeVisible(webView);
+
+    // A page kept from an earlier open missed what happened while it was hidden;
+    // one snapshot brings it up to date without a reload
+    if (reattaching)
+        rpcBridge.sendStateEvent("event.state", rpcBridge.getStateSnapshot());
 
     // Set editor size
     setSize(800, 600);
     setResizable(true, true);
     setResizeLimits(400, 300, 1920, 1080);
+
+    startTimerHz(30);
 }
 
 TuningMiddlewareHostEditor::~TuningMiddlewareHostEditor()
 {
+    stopTimer();
+
+    // The view stays with the processor for the next open
+    removeChildComponent(&webView);
 }
 
 void TuningMiddlewareHostEditor::paint(juce::Graphics& g)
@@ -28,6 +37,50 @@ void TuningMiddlewareHostEditor::paint(juce::Graphics& g)
 
 void TuningMiddlewareHostEditor::resized()
 {
-    if (webView)
-        webView->setBounds(getLocalBounds());
+    webView.setBounds(getLocalBounds());
+}
+
+void TuningMiddlewareHostEditor::timerCallback()
+{
+    // Program changes and CCs can switch presets on the audio thread
+    auto preset = processorRef.getTuningEngine().getCurrentPreset();
+
+    if (preset != lastReportedPreset)
+    {
+        lastReportedPreset = preset;
+
+        auto params = new juce::DynamicObject();
+        params->setProperty("index", preset);
+        rpcBridge.sendStateEvent("event.preset", juce::var(params));
+    }
+
+    auto& telemetry = processorRef.getTuningEngine().getTelemetry();
+
+    // Each event is [type, channel, note, inputNote, pitchBend, samplePosition]
+    static const char* const typeNames[] = { "on", "off", "bend" };
+    juce::Array<juce::var> events;
+
+    telemetry.drain([&](const VoiceTelemetry::Event& event)
+    {
+        events.add(juce::var(juce::Array<juce::var> {
+            typeNames[static_cast<int>(event.type)],
+            static_cast<int>(event.channel) + 1,
+            static_cast<int>(event.note),
+            static_cast<int>(event.inputNote),
+            static_cast<int>(event.pitchBend),
+            static_cast<int>(event.samplePosition)
+        }));
+    });
+
+    auto dropped = telemetry.getNumDropped();
+
+    if (events.isEmpty() && dropped == lastReportedDrops)
+        return;
+
+    lastReportedDrops = dropped;
+
+    auto params = new juce::DynamicObject();
+    params->setProperty("events", events);
+    params->setProperty("dropped", dropped);
+    rpcBridge.sendEvent("event.voices", juce::var(params));
 }
@@ -5,7 +5,8 @@
 #include "WebViewComponent.h"
 #include "RpcBridge.h"
 
-class TuningMiddlewareHostEditor : public juce::AudioProcessorEditor
+class TuningMiddlewareHostEditor : public juce::AudioProcessorEditor,
+                                   private juce::Timer
 {
 public:
     explicit TuningMiddlewareHostEditor(TuningMiddlewareHostProcessor&);
@@ -15,10 +16,17 @@ public:
     void resized() override;
 
 private:
+    // Drains voice telemetry and preset switches and forwards them to the WebView
+    void timerCallback() override;
+
     TuningMiddlewareHostProcessor& processorRef;
+    bool reattaching = false;
+    juce::int64 lastReportedDrops = 0;
+    int lastReportedPreset = -1;
     
-    std::unique_ptr<WebViewComponent> webView;
-    std::unique_ptr<RpcBridge> rpcBridge;
+    // Owned by the processor and kept between opens
+    RpcBridge& rpcBridge;
+    WebViewComponent& webView;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(TuningMiddlewareHostEditor)
 };
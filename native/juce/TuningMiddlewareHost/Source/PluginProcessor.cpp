@@ -1,15 +1,25 @@
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
+#include "StateFormat.h"
 
 TuningMiddlewareHostProcessor::TuningMiddlewareHostProcessor()
     : AudioProcessor(BusesProperties()
         .withInput("Input", juce::AudioChannelSet::stereo(), true)
         .withOutput("Output", juce::AudioChannelSet::stereo(), true))
 {
+    formatManager.addDefaultFormats();
+
+    // Scans are started from the page, so the bridge is there to take their progress
+    pluginScanner.setProgressCallback([this](const PluginScanner::Progress& progress)
+    {
+        if (rpcBridge != nullptr)
+            rpcBridge->sendPluginScanProgress(progress);
+    });
 }
 
 TuningMiddlewareHostProcessor::~TuningMiddlewareHostProcessor()
 {
+    TuningGroups::leave(tuningGroup);
 }
 
 const juce::String TuningMiddlewareHostProcessor::getName() const
@@ -22,19 +32,41 @@ bool TuningMiddlewareHostProcessor::producesMidi() const { return true; }
 bool TuningMiddlewareHostProcessor::isMidiEffect() const { return true; }
 double TuningMiddlewareHostProcessor::getTailLengthSeconds() const { return 0.0; }
 
-int TuningMiddlewareHostProcessor::getNumPrograms() { return 1; }
-int TuningMiddlewareHostProcessor::getCurrentProgram() { return 0; }
-void TuningMiddlewareHostProcessor::setCurrentProgram(int) {}
-const juce::String TuningMiddlewareHostProcessor::getProgramName(int) { return {}; }
+// Host programs are the tuning presets
+int TuningMiddlewareHostProcessor::getNumPrograms() { return TuningEngine::maxPresets; }
+int TuningMiddlewareHostProcessor::getCurrentProgram() { return tuningEngine.getCurrentPreset(); }
+void TuningMiddlewareHostProcessor::setCurrentProgram(int index) { tuningEngine.selectPreset(index); }
+const juce::String TuningMiddlewareHostProcessor::getProgramName(int index) { return "Preset " + juce::String(index + 1); }
 void TuningMiddlewareHostProcessor::changeProgramName(int, const juce::String&) {}
 
 void TuningMiddlewareHostProcessor::prepareToPlay(double sampleRate, int samplesPerBlock)
 {
-    juce::ignoreUnused(sampleRate, samplesPerBlock);
+    tuningEngine.prepare(sampleRate, samplesPerBlock);
+    blockStats.prepare(sampleRate);
+    preparedBlockSize = samplesPerBlock;
+
+    // processBlock isn't running, so a pending swap can complete right here
+    hostedPlugin.adoptWhileStopped();
+
+    auto numHostedChannels = minHostedChannels;
+
+    if (auto* plugin = hostedPlugin.getPlugin())
+    {
+        preparePlugin(*plugin);
+        numHostedChannels = juce::jmax(numHostedChannels, plugin->getTotalNumInputChannels(), plugin->getTotalNumOutputChannels());
+    }
+
+    hostedChannelBuffer.setSize(numHostedChannels, samplesPerBlock);
+    hostedMidiInput.ensureSize(tuningEngine.getReservedOutputBytes());
+    hostedMidiChunk.ensureSize(tuningEngine.getReservedOutputBytes());
 }
 
 void TuningMiddlewareHostProcessor::releaseResources()
 {
+    hostedPlugin.adoptWhileStopped();
+
+    if (auto* plugin = hostedPlugin.getPlugin())
+        plugin->releaseResources();
 }
 
 bool TuningMiddlewareHostProcessor::isBusesLayoutSupported(const BusesLayout& layouts) const
@@ -43,13 +75,253 @@ bool TuningMiddlewareHostProcessor::isBusesLayoutSupported(const BusesLayout& la
     return true;
 }
 
+TuningEngine::OutputProtocol TuningMiddlewareHostProcessor::getEffectiveOutputProtocol() const
+{
+    return hasUmpDestination() ? tuningEngine.getOutputProtocol() : TuningEngine::OutputProtocol::midi1;
+}
+
 void TuningMiddlewareHostProcessor::processBlock(juce::AudioBuffer<float>& buffer, 
                                                   juce::MidiBuffer& midiMessages)
 {
-    juce::ignoreUnused(buffer);
-    
-    // Process MIDI through tuning engine
-    tuningEngine.processBlock(midiMessages);
+    const BlockStats::Stopwatch callbackStopwatch;
+    auto reallocationsBefore = tuningEngine.getNumOutputReallocations();
+
+    midiCapture.beginBlock(midiMessages, buffer.getNumSamples());
+
+    {
+        const BlockStats::Stopwatch stopwatch;
+
+        // Process MIDI through tuning engine
+        tuningEngine.processBlock(midiMessages, buffer.getNumSamples());
+
+        blockStats.recordEngine(stopwatch.getElapsedTicks(), tuningEngine.getBlockEventsIn(), tuningEngine.getBlockEventsOut());
+    }
+
+    midiCapture.endBlock();
+
+    // Tuning engine -> hosted instrument, in one callback
+    if (auto* plugin = hostedPlugin.acquire())
+    {
+        const BlockStats::Stopwatch stopwatch;
+        processHostedPlugin(*plugin, buffer, midiMessages);
+        blockStats.recordHosted(stopwatch.getElapsedTicks());
+    }
+
+    blockStats.recordLoad(callbackStopwatch.getElapsedTicks(), buffer.getNumSamples());
+
+    // Outgrowing the storage reserved in prepare() allocated on the audio thread
+    jassert(tuningEngine.getNumOutputReallocations() == reallocationsBefore);
+    juce::ignoreUnused(reallocationsBefore);
+}
+
+void TuningMiddlewareHostProcessor::processHostedPlugin(juce::AudioPluginInstance& plugin, juce::AudioBuffer<float>& buffer,
+                                                        juce::MidiBuffer& midiMessages)
+{
+    auto numChannels = juce::jmax(plugin.getTotalNumInputChannels(), plugin.getTotalNumOutputChannels());
+
+    // Loaded while playing and wider than the storage reserved; the next
+    // prepareToPlay() sizes it for this plugin
+    if (numChannels > buffer.getNumChannels() && numChannels > hostedChannelBuffer.getNumChannels())
+    {
+        blockStats.recordHostedSkipped();
+        return;
+    }
+
+    auto numSamples = buffer.getNumSamples();
+
+    if (numSamples <= preparedBlockSize || preparedBlockSize <= 0)
+    {
+        processHostedChunk(plugin, buffer, midiMessages);
+        return;
+    }
+
+    // More samples than the host promised: play them in chunks the plugin was
+    // prepared for, moving each chunk's MIDI to its start and its output back
+    hostedMidiInput.clear();
+    hostedMidiInput.addEvents(midiMessages, 0, numSamples, 0);
+    midiMessages.clear();
+
+    for (int start = 0; start < numSamples; start += preparedBlockSize)
+    {
+        auto chunkSamples = juce::jmin(preparedBlockSize, numSamples - start);
+        juce::AudioBuffer<float> chunk(buffer.getArrayOfWritePointers(), buffer.getNumChannels(), start, chunkSamples);
+
+        hostedMidiChunk.clear();
+        hostedMidiChunk.addEvents(hostedMidiInput, start, chunkSamples, -start);
+        processHostedChunk(plugin, chunk, hostedMidiChunk);
+        midiMessages.addEvents(hostedMidiChunk, 0, chunkSamples, start);
+    }
+}
+
+void TuningMiddlewareHostProcessor::processHostedChunk(juce::AudioPluginInstance& plugin, juce::AudioBuffer<float>& buffer,
+                                                       juce::MidiBuffer& midiMessages)
+{
+    auto numChannels = juce::jmax(plugin.getTotalNumInputChannels(), plugin.getTotalNumOutputChannels());
+
+    if (numChannels <= buffer.getNumChannels())
+    {
+        plugin.processBlock(buffer, midiMessages);
+        return;
+    }
+
+    // Run the plugin on a wider view of the preallocated storage, then copy back what we can
+    juce::AudioBuffer<float> wideBuffer(hostedChannelBuffer.getArrayOfWritePointers(), numChannels, buffer.getNumSamples());
+    wideBuffer.clear();
+
+    for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+        wideBuffer.copyFrom(channel, 0, buffer, channel, 0, buffer.getNumSamples());
+
+    plugin.processBlock(wideBuffer, midiMessages);
+
+    for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+        buffer.copyFrom(channel, 0, wideBuffer, channel, 0, buffer.getNumSamples());
+}
+
+juce::String TuningMiddlewareHostProcessor::loadPlugin(const juce::String& fileOrIdentifier)
+{
+    JUCE_ASSERT_MESSAGE_THREAD
+
+    auto description = findPluginDescription(fileOrIdentifier);
+    if (description == nullptr)
+        return {};
+
+    instantiatePlugin(*description, startPluginRequest());
+    return description->createIdentifierString();
+}
+
+void TuningMiddlewareHostProcessor::unloadPlugin()
+{
+    JUCE_ASSERT_MESSAGE_THREAD
+
+    // A load still in flight would otherwise install itself afterwards
+    startPluginRequest();
+
+    const juce::ScopedLock sl(restoreLock);
+    hostedPlugin.setPlugin(nullptr);
+}
+
+int TuningMiddlewareHostProcessor::startPluginRequest()
+{
+    const juce::ScopedLock sl(restoreLock);
+    pendingRestore = {};
+    return ++pluginRequestId;
+}
+
+bool TuningMiddlewareHostProcessor::isCurrentPluginRequest(int requestId) const
+{
+    const juce::ScopedLock sl(restoreLock);
+    return requestId == pluginRequestId;
+}
+
+void TuningMiddlewareHostProcessor::finishPluginRequest(int requestId)
+{
+    const juce::ScopedLock sl(restoreLock);
+
+    if (requestId == pendingRestore.requestId)
+        pendingRestore = {};
+}
+
+void TuningMiddlewareHostProcessor::restorePlugin(const PendingRestore& restore)
+{
+    JUCE_ASSERT_MESSAGE_THREAD
+
+    if (! isCurrentPluginRequest(restore.requestId))
+        return; // superseded by a later load or restore
+
+    // The old instance shouldn't keep playing under a restored session
+    {
+        const juce::ScopedLock sl(restoreLock);
+        hostedPlugin.setPlugin(nullptr);
+    }
+
+    auto description = restore.pluginId.isNotEmpty() ? findPluginDescription(restore.pluginId) : nullptr;
+    if (description == nullptr)
+    {
+        finishPluginRequest(restore.requestId);
+        return;
+    }
+
+    instantiatePlugin(*description, restore.requestId, restore.state);
+}
+
+std::unique_ptr<juce::PluginDescription> TuningMiddlewareHostProcessor::findPluginDescription(const juce::String& fileOrIdentifier)
+{
+    // Prefer the scan cache; opening the file to describe it can be slow
+    auto& knownPlugins = pluginScanner.getKnownPlugins();
+    auto description = knownPlugins.getTypeForIdentifierString(fileOrIdentifier);
+
+    if (description == nullptr)
+        description = knownPlugins.getTypeForFile(fileOrIdentifier);
+
+    if (description == nullptr)
+    {
+        juce::OwnedArray<juce::PluginDescription> types;
+
+        for (auto* format : formatManager.getFormats())
+            if (format->fileMightContainThisPluginType(fileOrIdentifier))
+                format->findAllTypesForFile(types, fileOrIdentifier);
+
+        if (! types.isEmpty())
+            description = std::make_unique<juce::PluginDescription>(*types[0]);
+    }
+
+    return description;
+}
+
+void TuningMiddlewareHostProcessor::instantiatePlugin(const juce::PluginDescription& description, int requestId,
+                                                     std::shared_ptr<const juce::MemoryBlock> state)
+{
+    // Instantiation can take a while; the current plugin keeps playing meanwhile
+    formatManager.createPluginInstanceAsync(description, getSampleRate(), getBlockSize(),
+        [safeThis = juce::WeakReference<TuningMiddlewareHostProcessor>(this), requestId, state]
+        (std::unique_ptr<juce::AudioPluginInstance> instance, const juce::String& error)
+        {
+            juce::ignoreUnused(error);
+
+            auto* processor = safeThis.get();
+            if (processor == nullptr || ! processor->isCurrentPluginRequest(requestId))
+                return;
+
+            if (instance != nullptr)
+            {
+                // Restored before it can play, so the first block already sounds right
+                if (state != nullptr)
+                    instance->setStateInformation(state->getData(), (int) state->getSize());
+
+                processor->installPlugin(std::move(instance));
+            }
+
+            processor->finishPluginRequest(requestId);
+        });
+}
+
+void TuningMiddlewareHostProcessor::installPlugin(std::unique_ptr<juce::AudioPluginInstance> plugin)
+{
+    preparePlugin(*plugin);
+
+    const juce::ScopedLock sl(restoreLock);
+    hostedPlugin.setPlugin(std::move(plugin));
+}
+
+void TuningMiddlewareHostProcessor::preparePlugin(juce::AudioPluginInstance& plugin)
+{
+    // Prefer our own layout; otherwise settle for our output layout alone (the
+    // usual case for instruments), and finally whatever the plugin defaults to.
+    auto layout = getBusesLayout();
+
+    if (! plugin.setBusesLayout(layout))
+    {
+        layout.inputBuses.clear();
+
+        if (! plugin.setBusesLayout(layout))
+            plugin.enableAllBuses();
+    }
+
+    auto sampleRate = getSampleRate() > 0.0 ? getSampleRate() : 44100.0;
+    auto blockSize = getBlockSize() > 0 ? getBlockSize() : 512;
+
+    plugin.setRateAndBufferSizeDetails(sampleRate, blockSize);
+    plugin.prepareToPlay(sampleRate, blockSize);
 }
 
 bool TuningMiddlewareHostProcessor::hasEditor() const { return true; }
@@ -59,33 +331,184 @@ juce::AudioProcessorEditor* TuningMiddlewareHostProcessor::createEditor()
     return new TuningMiddlewareHostEditor(*this);
 }
 
+RpcBridge& TuningMiddlewareHostProcessor::getRpcBridge()
+{
+    if (rpcBridge == nullptr)
+        rpcBridge = std::make_unique<RpcBridge>(*this);
+
+    return *rpcBridge;
+}
+
+WebViewComponent& TuningMiddlewareHostProcessor::getWebView()
+{
+    if (webView == nullptr)
+        webView = std::make_unique<WebViewComponent>(getRpcBridge());
+
+    return *webView;
+}
+
 void TuningMiddlewareHostProcessor::getStateInformation(juce::MemoryBlock& destData)
 {
-    // Save tuning table and settings
-    juce::MemoryOutputStream stream(destData, true);
-    
-    auto& table = tuningEngine.getTuningTable();
-    for (int i = 0; i < 128; ++i)
-        stream.writeFloat(table[i]);
-    
-    stream.writeFloat(tuningEngine.getPitchBendRange());
+    TuningEngine::SavedState engineState;
+    tuningEngine.copyState(engineState);
+
+    StateFormat::Writer writer(destData);
+    StateFormat::writeTuningEngine(writer, engineState);
+
+    auto groupId = getTuningGroup();
+
+    if (groupId.isNotEmpty())
+        writer.addChunk(StateFormat::tuningGroupChunk, groupId.toRawUTF8(), groupId.getNumBytesAsUTF8());
+
+    // A restore still in flight saves what it was given, so a quick save after
+    // a load doesn't drop the plugin
+    const juce::ScopedLock sl(restoreLock);
+
+    if (pendingRestore.requestId != 0)
+    {
+        if (pendingRestore.pluginId.isNotEmpty())
+            StateFormat::writePlugin(writer, pendingRestore.pluginId, *pendingRestore.state);
+    }
+    else if (auto* plugin = hostedPlugin.getPlugin())
+    {
+        juce::MemoryBlock pluginState;
+        plugin->getStateInformation(pluginState);
+        StateFormat::writePlugin(writer, plugin->getPluginDescription().fileOrIdentifier, pluginState);
+    }
 }
 
 void TuningMiddlewareHostProcessor::setStateInformation(const void* data, int sizeInBytes)
 {
-    juce::MemoryInputStream stream(data, static_cast<size_t>(sizeInBytes), false);
-    
-    std::array<float, 128> table;
-    for (int i = 0; i < 128; ++i)
-        table[i] = stream.readFloat();
-    
-    tuningEngine.setTuningTable(table);
-    tuningEngine.setPitchBendRange(stream.readFloat());
+    StateFormat::EngineState state;
+    StateFormat::Reader reader(data, static_cast<size_t>(juce::jmax(0, sizeInBytes)));
+    juce::String groupId;
+    PendingRestore restore;
+
+    if (reader.isValid())
+    {
+        StateFormat::Chunk chunk;
+        while (reader.next(chunk))
+        {
+            const juce::uint8* pluginData = nullptr;
+            size_t pluginSize = 0;
+
+            if (chunk.id == StateFormat::tuningGroupChunk)
+                groupId = juce::String::fromUTF8(reinterpret_cast<const char*>(chunk.data), (int) chunk.size);
+            else if (StateFormat::readPluginChunk(chunk, restore.pluginId, pluginData, pluginSize))
+                restore.state = std::make_shared<const juce::MemoryBlock>(pluginData, pluginSize);
+            else
+                StateFormat::readTuningEngineChunk(chunk, state);
+        }
+    }
+    else if (! StateFormat::readLegacyTuningEngine(data, static_cast<size_t>(juce::jmax(0, sizeInBytes)), state))
+    {
+        return;
+    }
+
+    {
+        // Out of any group first, so the table restored is the one a new group
+        // starts from; the lock keeps a regroup from landing in between
+        const juce::ScopedLock sl(groupLock);
+        setTuningGroup({});
+        StateFormat::restoreTuningEngine(state, tuningEngine);
+
+        // A group that is already playing keeps its table; otherwise it takes ours
+        setTuningGroup(groupId);
+    }
+
+    // Instantiating happens later on the message thread; until the instance is
+    // ready, tuned MIDI passes through. A session without a plugin unloads ours.
+    if (restore.state == nullptr)
+        restore.pluginId = {};
+
+    {
+        const juce::ScopedLock sl(restoreLock);
+        restore.requestId = ++pluginRequestId;
+        pendingRestore = restore;
+    }
+
+    juce::MessageManager::callAsync([safeThis = juce::WeakReference<TuningMiddlewareHostProcessor>(this), restore]
+    {
+        if (auto* processor = safeThis.get())
+            processor->restorePlugin(restore);
+    });
 }
 
 void TuningMiddlewareHostProcessor::setTuningTable(const std::array<float, 128>& cents)
 {
-    tuningEngine.setTuningTable(cents);
+    // A copy, so a regroup meanwhile can't release the table under us
+    auto groupTable = getGroupTable();
+
+    if (groupTable != nullptr)
+        groupTable->publish(cents);
+    else
+        tuningEngine.setTuningTable(cents);
+}
+
+void TuningMiddlewareHostProcessor::setTuningEntries(const juce::uint8* notes, const float* cents, int numEntries)
+{
+    auto groupTable = getGroupTable();
+
+    if (groupTable == nullptr)
+    {
+        tuningEngine.setTuningEntries(notes, cents, numEntries);
+        return;
+    }
+
+    // The group gets the whole edited table, so members can't drift apart
+    std::array<float, 128> table;
+    groupTable->read(table);
+
+    for (int i = 0; i < numEntries; ++i)
+        if (notes[i] < 128)
+            table[notes[i]] = cents[i];
+
+    groupTable->publish(table);
+}
+
+bool TuningMiddlewareHostProcessor::setTuningFromPresets(int from, int to, float amount, float stretch, float transposeCents)
+{
+    auto groupTable = getGroupTable();
+
+    if (groupTable == nullptr)
+        return tuningEngine.setTuningFromPresets(from, to, amount, stretch, transposeCents);
+
+    std::array<float, 128> table;
+
+    if (! tuningEngine.getTuningFromPresets(from, to, amount, stretch, transposeCents, table))
+        return false;
+
+    groupTable->publish(table);
+    return true;
+}
+
+void TuningMiddlewareHostProcessor::setTuningGroup(const juce::String& groupId)
+{
+    // Held throughout, so two regroups can't interleave their leave and join
+    const juce::ScopedLock sl(groupLock);
+
+    if (groupId == tuningGroup)
+        return;
+
+    // Our engine keeps playing the old group's table, and a new group starts from it
+    tuningEngine.setSharedTable(nullptr);
+    TuningGroups::leave(tuningGroup);
+
+    tuningGroup = groupId;
+    groupTable = TuningGroups::join(groupId, tuningEngine.getTuningTable());
+    tuningEngine.setSharedTable(groupTable);
+}
+
+juce::String TuningMiddlewareHostProcessor::getTuningGroup() const
+{
+    const juce::ScopedLock sl(groupLock);
+    return tuningGroup;
+}
+
+SharedTable::Ptr TuningMiddlewareHostProcessor::getGroupTable() const
+{
+    const juce::ScopedLock sl(groupLock);
+    return groupTable;
 }
 
 void TuningMiddlewareHostProcessor::setPitchBendRange(float semitones)
@@ -2,6 +2,15 @@
 
 #include <JuceHeader.h>
 #include "TuningEngine.h"
+#include "TuningGroups.h"
+#include "BlockStats.h"
+#include "MidiCapture.h"
+#include "MtsEspMaster.h"
+#include "HostedPluginSlot.h"
+#include "PluginScanner.h"
+
+class RpcBridge;
+class WebViewComponent;
 
 class TuningMiddlewareHostProcessor : public juce::AudioProcessor
 {
@@ -39,12 +48,114 @@ public:
     TuningEngine& getTuningEngine() { return tuningEngine; }
     const TuningEngine& getTuningEngine() const { return tuningEngine; }
 
-    // Set tuning table from UI
+    // The host is handed MIDI 1.0 only, so a MIDI 2.0 output protocol is kept and
+    // saved, for a destination that takes packets, but plays as MIDI 1.0 here
+    bool hasUmpDestination() const { return false; }
+    TuningEngine::OutputProtocol getEffectiveOutputProtocol() const;
+
+    // Per-block cost of processBlock, readable from any thread
+    const BlockStats::AudioCallback& getBlockStats() const { return blockStats; }
+
+    // Input and engine state as played, for TuningEngineReplay
+    MidiCapture::Recorder& getMidiCapture() { return midiCapture; }
+
+    // Broadcasts the engine's tuning to MTS-ESP clients while this is the session's master
+    MtsEspMaster& getMtsEspMaster() { return mtsEspMaster; }
+
+    // Hosted instrument, played with the tuned MIDI in the same callback; with
+    // nothing loaded the MIDI passes through. Message thread. Instantiating is
+    // asynchronous and the current plugin plays until its replacement is ready.
+    // The plugin and its state are saved with ours and reloaded on restore.
+    // Returns the identifier of the plugin being loaded, or empty when nothing
+    // matches the file or identifier.
+    juce::String loadPlugin(const juce::String& fileOrIdentifier);
+    void unloadPlugin();
+    juce::AudioPluginInstance* getHostedPlugin() const { return hostedPlugin.getPlugin(); }
+
+    // Background scan with an on-disk cache; progress goes to the WebView as
+    // event.pluginScan. Loads look the plugin up in its list first.
+    PluginScanner& getPluginScanner() { return pluginScanner; }
+
+    // Set tuning table from UI. In a group the edit is published once to the
+    // group's table, which every member plays from its next block.
     void setTuningTable(const std::array<float, 128>& cents);
+    void setTuningEntries(const juce::uint8* notes, const float* cents, int numEntries);
+    bool setTuningFromPresets(int from, int to, float amount, float stretch, float transposeCents);
     void setPitchBendRange(float semitones);
 
+    // The editor's WebView and bridge outlive the editor, so reopening it reattaches
+    // the loaded page instead of starting a browser. Created on first use; message
+    // thread only.
+    bool hasWebView() const { return webView != nullptr; }
+
+    // Instances in the same group play one table; an empty id plays alone.
+    // Saved with the state, so a session reload regroups its instances.
+    void setTuningGroup(const juce::String& groupId);
+    juce::String getTuningGroup() const;
+    WebViewComponent& getWebView();
+    RpcBridge& getRpcBridge();
+
 private:
+    // Each load, unload or restore gets an id; a newer request cancels older ones in flight
+    struct PendingRestore
+    {
+        int requestId = 0;
+        juce::String pluginId;
+        std::shared_ptr<const juce::MemoryBlock> state;   // shared, never copied
+    };
+
+    int startPluginRequest();
+    bool isCurrentPluginRequest(int requestId) const;
+    void finishPluginRequest(int requestId);
+    void restorePlugin(const PendingRestore& restore);
+
+    std::unique_ptr<juce::PluginDescription> findPluginDescription(const juce::String& fileOrIdentifier);
+    void instantiatePlugin(const juce::PluginDescription& description, int requestId,
+                           std::shared_ptr<const juce::MemoryBlock> state = nullptr);
+
+    // Match buses and playback settings, then hand the instance to the audio thread
+    void installPlugin(std::unique_ptr<juce::AudioPluginInstance> plugin);
+    void preparePlugin(juce::AudioPluginInstance& plugin);
+    void processHostedPlugin(juce::AudioPluginInstance& plugin, juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages);
+    void processHostedChunk(juce::AudioPluginInstance& plugin, juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages);
+
     TuningEngine tuningEngine;
+    BlockStats::AudioCallback blockStats;
+    MidiCapture::Recorder midiCapture { tuningEngine };
+    MtsEspMaster mtsEspMaster { tuningEngine };
+    // The host may restore, and so regroup, off the message thread
+    mutable juce::CriticalSection groupLock;
+    juce::String tuningGroup;
+    SharedTable::Ptr groupTable;
+
+    SharedTable::Ptr getGroupTable() const;
+
+    juce::AudioPluginFormatManager formatManager;
+    PluginScanner pluginScanner { formatManager };
+    HostedPluginSlot hostedPlugin;
+
+    // The host may save or restore off the message thread
+    mutable juce::CriticalSection restoreLock;
+    PendingRestore pendingRestore;
+    int pluginRequestId = 0;
+
+    // Lets the hosted plugin use more channels than the host gave us. Sized in
+    // prepareToPlay() for the plugin's layout, and never below minHostedChannels
+    // so most plugins loaded while playing fit too; the audio thread only ever
+    // takes a view of it.
+    static constexpr int minHostedChannels = 16;
+    juce::AudioBuffer<float> hostedChannelBuffer;
+
+    // A block larger than the one the plugin was prepared for is played in chunks
+    // of preparedBlockSize, each with its share of the MIDI. Reserved in
+    // prepareToPlay() to hold a block of the engine's output.
+    int preparedBlockSize = 0;
+    juce::MidiBuffer hostedMidiInput, hostedMidiChunk;
+
+    // Destroyed in reverse order, so the view goes before the bridge it calls
+    std::unique_ptr<RpcBridge> rpcBridge;
+    std::unique_ptr<WebViewComponent> webView;
     
+    JUCE_DECLARE_WEAK_REFERENCEABLE(TuningMiddlewareHostProcessor)
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(TuningMiddlewareHostProcessor)
 };
@@ -0,0 +1,131 @@
+#include "PluginScanner.h"
+
+PluginScanner::PluginScanner(juce::AudioPluginFormatManager& manager)
+    : juce::Thread("Plugin Scanner"),
+      formatManager(manager)
+{
+    loadCache();
+}
+
+PluginScanner::~PluginScanner()
+{
+    cancelScan();
+}
+
+void PluginScanner::startScan()
+{
+    JUCE_ASSERT_MESSAGE_THREAD
+
+    if (isThreadRunning())
+        return;
+
+    startThread(juce::Thread::Priority::low);
+}
+
+void PluginScanner::cancelScan()
+{
+    // Opening a plugin can't be interrupted, so allow the current one to finish
+    stopThread(10000);
+}
+
+void PluginScanner::run()
+{
+    auto numFormats = formatManager.getNumFormats();
+
+    for (int i = 0; i < numFormats && !threadShouldExit(); ++i)
+        if (auto* format = formatManager.getFormat(i))
+            if (!scanFormat(*format, i, numFormats))
+                break;
+
+    removeMissingPlugins();
+    saveCache();
+
+    Progress done;
+    done.progress = 1.0f;
+    done.numFound = knownPlugins.getNumTypes();
+    done.finished = true;
+    postProgress(done);
+}
+
+bool PluginScanner::scanFormat(juce::AudioPluginFormat& format, int formatIndex, int numFormats)
+{
+    // Formats that register with the OS (AU) ignore the path and enumerate anyway
+    juce::PluginDirectoryScanner scanner(knownPlugins, format, format.getDefaultLocationsToSearch(), true,
+                                         getDataDirectory().getChildFile("ScanInProgress.txt"),
+                                         true);
+
+    juce::String nextName;
+
+    for (;;)
+    {
+        if (threadShouldExit())
+            return false;
+
+        Progress progress;
+        progress.formatName = format.getName();
+        progress.currentPlugin = scanner.getNextPluginFileThatWillBeScanned();
+        progress.progress = (formatIndex + juce::jlimit(0.0f, 1.0f, scanner.getProgress())) / (float) numFormats;
+        progress.numFound = knownPlugins.getNumTypes();
+        postProgress(progress);
+
+        // Files whose modification time matches the cache are skipped inside
+        if (!scanner.scanNextFile(true, nextName))
+            break;
+    }
+
+    return true;
+}
+
+void PluginScanner::removeMissingPlugins()
+{
+    for (auto& type : knownPlugins.getTypes())
+    {
+        for (auto* format : formatManager.getFormats())
+        {
+            if (format->getName() == type.pluginFormatName)
+            {
+                if (!format->doesPluginStillExist(type))
+                    knownPlugins.removeType(type);
+                break;
+            }
+        }
+    }
+}
+
+void PluginScanner::postProgress(Progress progress)
+{
+    auto now = juce::Time::getMillisecondCounter();
+
+    if (!progress.finished && now - lastProgressTime < 100)
+        return;
+
+    lastProgressTime = now;
+
+    juce::MessageManager::callAsync([safeThis = juce::WeakReference<PluginScanner>(this), progress]
+    {
+        if (auto* scanner = safeThis.get())
+            if (scanner->progressCallback)
+                scanner->progressCallback(progress);
+    });
+}
+
+//==============================================================================
+juce::File PluginScanner::getDataDirectory()
+{
+    auto dir = juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+                   .getChildFile("TuningMiddleware");
+    dir.createDirectory();
+    return dir;
+}
+
+void PluginScanner::loadCache()
+{
+    if (auto xml = juce::XmlDocument::parse(getDataDirectory().getChildFile("PluginCache.xml")))
+        knownPlugins.recreateFromXml(*xml);
+}
+
+void PluginScanner::saveCache() const
+{
+    if (auto xml = knownPlugins.createXml())
+        xml->writeTo(getDataDirectory().getChildFile("PluginCache.xml"));
+}
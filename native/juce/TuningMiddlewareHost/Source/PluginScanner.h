@@ -0,0 +1,62 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+/**
+ * PluginScanner - Finds installed plugins on a worker thread
+ *
+ * Results live in a KnownPluginList that is cached on disk. Each listing keeps
+ * the file's modification time, so a rescan only re-opens files that changed.
+ * While a plugin is being opened its path is recorded in a "dead man's pedal"
+ * file. If it crashes the host, the next scan blacklists it rather than dying
+ * on it again.
+ */
+class PluginScanner : private juce::Thread
+{
+public:
+    struct Progress
+    {
+        juce::String formatName;
+        juce::String currentPlugin;  // file or identifier being opened
+        float progress = 0.0f;       // 0..1 across all formats
+        int numFound = 0;
+        bool finished = false;
+    };
+
+    // Called on the message thread
+    using ProgressCallback = std::function<void(const Progress&)>;
+
+    explicit PluginScanner(juce::AudioPluginFormatManager& formatManager);
+    ~PluginScanner() override;
+
+    void setProgressCallback(ProgressCallback callback) { progressCallback = std::move(callback); }
+
+    // Message thread. Does nothing if a scan is already running.
+    void startScan();
+    void cancelScan();
+    bool isScanning() const { return isThreadRunning(); }
+
+    // Safe to read from any thread; KnownPluginList locks internally
+    juce::KnownPluginList& getKnownPlugins() { return knownPlugins; }
+
+private:
+    void run() override;
+    bool scanFormat(juce::AudioPluginFormat& format, int formatIndex, int numFormats);
+    void removeMissingPlugins();
+    void postProgress(Progress progress);
+
+    void loadCache();
+    void saveCache() const;
+
+    static juce::File getDataDirectory();
+
+    juce::AudioPluginFormatManager& formatManager;
+    juce::KnownPluginList knownPlugins;
+    ProgressCallback progressCallback;
+
+    // Progress reports are throttled; the UI only needs a few per second
+    juce::uint32 lastProgressTime = 0;
+
+    JUCE_DECLARE_WEAK_REFERENCEABLE(PluginScanner)
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PluginScanner)
+};
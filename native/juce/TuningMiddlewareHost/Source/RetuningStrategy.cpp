@@ -0,0 +1,67 @@
+#include "RetuningStrategy.h"
+
+namespace
+{
+    // 5-limit just intervals per semitone class, in cents:
+    // 1/1 16/15 9/8 6/5 5/4 4/3 45/32 3/2 8/5 5/3 9/5 15/8
+    constexpr double justCents[12] = {
+        0.0, 111.731, 203.910, 315.641, 386.314, 498.045,
+        590.224, 701.955, 813.686, 884.359, 1017.596, 1088.269
+    };
+
+    // Splits an equal-tempered interval into octaves and a class in 0..11
+    void splitInterval(int semitones, int& octaves, int& intervalClass)
+    {
+        octaves = semitones >= 0 ? semitones / 12 : -((11 - semitones) / 12);
+        intervalClass = semitones - octaves * 12;
+    }
+}
+
+RetuningStrategy::Ptr RetuningStrategy::create(const juce::String& strategyName)
+{
+    if (strategyName == AdaptiveJustStrategy::name)
+        return new AdaptiveJustStrategy();
+
+    return nullptr;
+}
+
+double AdaptiveJustStrategy::getDissonance(double interval)
+{
+    auto cents = std::abs(interval) * 100.0;
+    auto semitones = juce::roundToInt(cents / 100.0);
+
+    int octaves, intervalClass;
+    splitInterval(semitones, octaves, intervalClass);
+
+    return std::abs(cents - (octaves * 1200.0 + justCents[intervalClass]));
+}
+
+double AdaptiveJustStrategy::choosePitch(int note, double staticPitch, const HeldNoteSet& held)
+{
+    auto bestPitch = staticPitch;
+    auto bestScore = std::numeric_limits<double>::max();
+
+    for (const auto& reference : held)
+    {
+        int octaves, intervalClass;
+        splitInterval(note - reference.note, octaves, intervalClass);
+
+        // Just above or below the reference as it is actually sounding
+        auto candidate = reference.pitch + octaves * 12.0 + justCents[intervalClass] / 100.0;
+
+        if (std::abs(candidate - staticPitch) * 100.0 > maxDriftCents)
+            continue;
+
+        auto score = 0.0;
+        for (const auto& other : held)
+            score += getDissonance(candidate - other.pitch);
+
+        if (score < bestScore)
+        {
+            bestScore = score;
+            bestPitch = candidate;
+        }
+    }
+
+    return bestPitch;
+}
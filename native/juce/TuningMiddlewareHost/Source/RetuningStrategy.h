@@ -0,0 +1,52 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "HeldNoteSet.h"
+
+/**
+ * RetuningStrategy - Picks a new note's pitch from the notes already sounding
+ *
+ * Strategies run on the audio thread once per note-on. They must not allocate,
+ * lock or block, and their cost must be bounded by the number of held notes.
+ * Strategies are reference counted, so the engine can swap them between blocks
+ * while the audio thread still holds the previous one.
+ */
+class RetuningStrategy : public juce::ReferenceCountedObject
+{
+public:
+    using Ptr = juce::ReferenceCountedObjectPtr<RetuningStrategy>;
+
+    ~RetuningStrategy() override = default;
+
+    // `staticPitch` is what table tuning would play, as a fractional MIDI note.
+    // `held` doesn't contain the new note yet.
+    virtual double choosePitch(int note, double staticPitch, const HeldNoteSet& held) = 0;
+
+    // Stable identifier used by RPC and saved state
+    virtual juce::String getName() const = 0;
+
+    // nullptr for "off" and unknown names
+    static Ptr create(const juce::String& name);
+};
+
+/**
+ * AdaptiveJustStrategy - 5-limit just intonation against the held chord
+ *
+ * Each held note proposes a pitch at a just interval from itself. The proposal
+ * that is most consonant with the whole chord wins. Proposals that stray more
+ * than maxDriftCents from static tuning are rejected to stop comma drift.
+ * O(n^2) in the number of held notes.
+ */
+class AdaptiveJustStrategy : public RetuningStrategy
+{
+public:
+    static constexpr const char* name = "adaptiveJust";
+    static constexpr double maxDriftCents = 50.0;
+
+    double choosePitch(int note, double staticPitch, const HeldNoteSet& held) override;
+    juce::String getName() const override { return name; }
+
+private:
+    // Distance in cents from an interval (in semitones) to the nearest just one
+    static double getDissonance(double interval);
+};
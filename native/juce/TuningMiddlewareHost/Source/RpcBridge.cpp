@@ -1,5 +1,71 @@
 #include "RpcBridge.h"
 #include "PluginProcessor.h"
+#include "TuningCodec.h"
+#include "StateFormat.h"
+
+namespace
+{
+    // Indexed by TuningEngine::OutputProtocol
+    const char* const protocolNames[] = { "midi1", "midi2PitchAttribute", "midi2PerNoteBend" };
+
+    // The same check TuningCodec makes on binary frames: every value must survive
+    // the cast to float, as NaN or inf would reach the pitch bends unchecked
+    std::array<float, 128> readCentsTable(const juce::var& tuningArray)
+    {
+        if (!tuningArray.isArray() || tuningArray.size() != 128)
+            throw std::runtime_error("tuningTable must be an array of 128 values");
+
+        std::array<float, 128> table;
+        for (int i = 0; i < 128; ++i)
+        {
+            table[(size_t) i] = static_cast<float>(static_cast<double>(tuningArray[i]));
+
+            if (!std::isfinite(table[(size_t) i]))
+                throw std::runtime_error("tuningTable values must be finite cents");
+        }
+
+        return table;
+    }
+
+    juce::var toVar(const BlockStats::Summary& summary)
+    {
+        auto result = new juce::DynamicObject();
+        result->setProperty("count", summary.count);
+        result->setProperty("min", summary.min);
+        result->setProperty("avg", summary.average);
+        result->setProperty("max", summary.max);
+        result->setProperty("p99", summary.p99);
+        return juce::var(result);
+    }
+
+    juce::var toVar(const MidiCapture::Recorder::Status& status)
+    {
+        auto result = new juce::DynamicObject();
+        result->setProperty("recording", status.recording);
+        result->setProperty("overflowed", status.overflowed);
+        result->setProperty("blocks", status.blocks);
+        result->setProperty("bytes", status.bytesWritten);
+        result->setProperty("path", status.file.getFullPathName());
+        return juce::var(result);
+    }
+
+    // The PluginInfo the page expects
+    juce::var toVar(const juce::PluginDescription& description)
+    {
+        auto format = description.pluginFormatName == "AudioUnit" ? juce::String("au")
+                                                                  : description.pluginFormatName.toLowerCase();
+
+        auto result = new juce::DynamicObject();
+        result->setProperty("id", description.createIdentifierString());
+        result->setProperty("name", description.name);
+        result->setProperty("path", description.fileOrIdentifier);
+        result->setProperty("format", format);
+        result->setProperty("manufacturer", description.manufacturerName);
+        result->setProperty("version", description.version);
+        result->setProperty("category", description.category);
+        return juce::var(result);
+    }
+}
 
 RpcBridge::RpcBridge(TuningMiddlewareHostProcessor& p)
     : processor(p)
@@ -8,6 +74,9 @@ RpcBridge::RpcBridge(TuningMiddlewareHostProcessor& p)
 
 juce::String RpcBridge::handleRequest(const juce::String& jsonRequest)
 {
+    if (jsonRequest.startsWithChar(TuningCodec::framePrefix))
+        return handleBinaryRequest(jsonRequest);
+
     auto json = juce::JSON::parse(jsonRequest);
     
     if (!json.isObject())
@@ -28,8 +97,58 @@ juce::String RpcBridge::handleRequest(const juce::String& jsonRequest)
             result = handleSetTuning(params);
         else if (method == "midi.setPitchBendRange")
             result = handleSetPitchBendRange(params);
+        else if (method == "midi.setInputPitchBendRange")
+            result = handleSetInputPitchBendRange(params);
+        else if (method == "midi.setNoteMapping")
+            result = handleSetNoteMapping(params);
+        else if (method == "midi.setHeldNoteRetune")
+            result = handleSetHeldNoteRetune(params);
+        else if (method == "midi.setVoiceAllocation")
+            result = handleSetVoiceAllocation(params);
+        else if (method == "midi.setFrequencySet")
+            result = handleSetFrequencySet(params);
+        else if (method == "midi.setDynamicTuning")
+            result = handleSetDynamicTuning(params);
+        else if (method == "midi.setOutputProtocol")
+            result = handleSetOutputProtocol(params);
+        else if (method == "midi.setTuningGroup")
+            result = handleSetTuningGroup(params);
+        else if (method == "midi.setPreset")
+            result = handleSetPreset(params);
+        else if (method == "midi.selectPreset")
+            result = handleSelectPreset(params);
+        else if (method == "midi.morphTables")
+            result = handleMorphTables(params);
+        else if (method == "midi.transformTable")
+            result = handleTransformTable(params);
+        else if (method == "midi.setPresetSwitching")
+            result = handleSetPresetSwitching(params);
         else if (method == "getState")
             result = handleGetState(params);
+        else if (method == "events.configure")
+            result = handleConfigureEvents(params);
+        else if (method == "events.getStats")
+            result = handleGetEventStats(params);
+        else if (method == "getStats")
+            result = handleGetStats(params);
+        else if (method == "capture.start")
+            result = handleStartCapture(params);
+        else if (method == "capture.stop")
+            result = handleStopCapture(params);
+        else if (method == "state.save")
+            result = handleSaveState(params);
+        else if (method == "mts.register")
+            result = handleRegisterMts(params);
+        else if (method == "mts.broadcast")
+            result = handleBroadcastMts(params);
+        else if (method == "mts.getClientCount")
+            result = handleGetMtsClientCount(params);
+        else if (method == "plugin.scan")
+            result = handleScanPlugins(params);
+        else if (method == "plugin.load")
+            result = handleLoadPlugin(params);
+        else if (method == "plugin.unload")
+            result = handleUnloadPlugin(params);
         else
             return createErrorResponse(id, -32601, "Method not found: " + method);
 
@@ -41,17 +160,29 @@ juce::String RpcBridge::handleRequest(const juce::String& jsonRequest)
     }
 }
 
-juce::var RpcBridge::handleSetTuning(const juce::var& params)
+juce::String RpcBridge::handleBinaryRequest(const juce::String& frameText)
 {
-    auto tuningArray = params.getProperty("tuningTable", juce::var());
-    
-    if (!tuningArray.isArray() || tuningArray.size() != 128)
-        throw std::runtime_error("tuningTable must be an array of 128 values");
+    // The fast path never builds a juce::var, and neither does its reply
+    TuningCodec::Frame frame;
 
-    std::array<float, 128> table;
-    for (int i = 0; i < 128; ++i)
-        table[i] = static_cast<float>(tuningArray[i]);
+    if (! TuningCodec::decode(frameText.toRawUTF8(), frameText.getNumBytesAsUTF8(), frame))
+        return createErrorResponse(0, -32700, "Parse error: malformed binary frame");
+
+    static_assert(TuningCodec::maxFrequencies == TuningEngine::maxFrequencies, "frequency set sizes differ");
 
+    if (frame.type == TuningCodec::FrameType::fullTable)
+        processor.setTuningTable(frame.cents);
+    else if (frame.type == TuningCodec::FrameType::delta)
+        processor.setTuningEntries(frame.notes.data(), frame.cents.data(), frame.numEntries);
+    else
+        processor.getTuningEngine().setFrequencySet(frame.frequencies.data(), frame.numFrequencies);
+
+    return "{\"jsonrpc\":\"2.0\",\"id\":" + juce::String(frame.requestId) + ",\"result\":true}";
+}
+
+juce::var RpcBridge::handleSetTuning(const juce::var& params)
+{
+    auto table = readCentsTable(params.getProperty("tuningTable", juce::var()));
     processor.setTuningTable(table);
     return juce::var(true);
 }
@@ -63,32 +194,493 @@ juce::var RpcBridge::handleSetPitchBendRange(const juce::var& params)
     return juce::var(true);
 }
 
+juce::var RpcBridge::handleSetInputPitchBendRange(const juce::var& params)
+{
+    auto range = static_cast<float>(params.getProperty("semitones", 2.0));
+    processor.getTuningEngine().setInputPitchBendRange(range);
+    return juce::var(true);
+}
+
+juce::var RpcBridge::handleSetNoteMapping(const juce::var& params)
+{
+    auto modeName = params.getProperty("mode", "sameKey").toString();
+
+    if (modeName == "sameKey")
+        processor.getTuningEngine().setNoteMapping(TuningEngine::NoteMapping::sameKey);
+    else if (modeName == "nearestKey")
+        processor.getTuningEngine().setNoteMapping(TuningEngine::NoteMapping::nearestKey);
+    else
+        throw std::runtime_error("mode must be sameKey or nearestKey");
+
+    return juce::var(true);
+}
+
+juce::var RpcBridge::handleSetHeldNoteRetune(const juce::var& params)
+{
+    auto modeName = params.getProperty("mode", "off").toString();
+    auto glideMs = static_cast<float>(params.getProperty("glideMs", 20.0));
+
+    TuningEngine::HeldNoteRetune mode;
+
+    if (modeName == "off")
+        mode = TuningEngine::HeldNoteRetune::off;
+    else if (modeName == "immediate")
+        mode = TuningEngine::HeldNoteRetune::immediate;
+    else if (modeName == "glide")
+        mode = TuningEngine::HeldNoteRetune::glide;
+    else
+        throw std::runtime_error("mode must be one of off, immediate, glide");
+
+    processor.getTuningEngine().setHeldNoteRetune(mode, glideMs);
+    return juce::var(true);
+}
+
+juce::var RpcBridge::handleSetVoiceAllocation(const juce::var& params)
+{
+    auto modeName = params.getProperty("mode", "channel").toString();
+
+    VoiceAllocator::Config config;
+
+    if (modeName == "channel")
+        config.mode = VoiceAllocator::Mode::inputChannel;
+    else if (modeName == "roundRobin")
+        config.mode = VoiceAllocator::Mode::roundRobin;
+    else if (modeName == "mpeLower")
+        config.mode = VoiceAllocator::Mode::mpeLowerZone;
+    else if (modeName == "mpeUpper")
+        config.mode = VoiceAllocator::Mode::mpeUpperZone;
+    else
+        throw std::runtime_error("mode must be one of channel, roundRobin, mpeLower, mpeUpper");
+
+    // Channels are 1-based on the wire
+    config.firstChannel = static_cast<int>(params.getProperty("firstChannel", 1)) - 1;
+    config.lastChannel = static_cast<int>(params.getProperty("lastChannel", 16)) - 1;
+    config.numMemberChannels = params.getProperty("memberChannels", 15);
+
+    processor.getTuningEngine().setVoiceAllocation(config);
+    return juce::var(true);
+}
+
+juce::var RpcBridge::handleSetFrequencySet(const juce::var& params)
+{
+    auto frequencyArray = params.getProperty("frequencies", juce::var());
+
+    if (!frequencyArray.isArray() || frequencyArray.size() > TuningEngine::maxFrequencies)
+        throw std::runtime_error("frequencies must be an array of at most " + std::to_string(TuningEngine::maxFrequencies) + " values");
+
+    std::array<double, TuningEngine::maxFrequencies> frequencies;
+    for (int i = 0; i < frequencyArray.size(); ++i)
+        frequencies[(size_t) i] = static_cast<double>(frequencyArray[i]);
+
+    processor.getTuningEngine().setFrequencySet(frequencies.data(), frequencyArray.size());
+    return juce::var(true);
+}
+
+juce::var RpcBridge::handleSetDynamicTuning(const juce::var& params)
+{
+    auto strategyName = params.getProperty("strategy", "off").toString();
+    auto strategy = RetuningStrategy::create(strategyName);
+
+    if (strategy == nullptr && strategyName != "off")
+        throw std::runtime_error("strategy must be off or adaptiveJust");
+
+    processor.getTuningEngine().setRetuningStrategy(strategy);
+    return juce::var(true);
+}
+
+juce::var RpcBridge::handleSetOutputProtocol(const juce::var& params)
+{
+    auto protocolName = params.getProperty("protocol", "midi1").toString();
+
+    TuningEngine::OutputProtocol protocol;
+
+    if (protocolName == "midi1")
+        protocol = TuningEngine::OutputProtocol::midi1;
+    else if (protocolName == "midi2PitchAttribute")
+        protocol = TuningEngine::OutputProtocol::midi2PitchAttribute;
+    else if (protocolName == "midi2PerNoteBend")
+        protocol = TuningEngine::OutputProtocol::midi2PerNoteBend;
+    else
+        throw std::runtime_error("protocol must be midi1, midi2PitchAttribute or midi2PerNoteBend");
+
+    processor.getTuningEngine().setOutputProtocol(protocol);
+
+    // Without a destination that takes packets the MIDI 2.0 modes play as MIDI 1.0
+    auto result = new juce::DynamicObject();
+    result->setProperty("protocol", protocolName);
+    result->setProperty("effectiveProtocol", protocolNames[static_cast<int>(processor.getEffectiveOutputProtocol())]);
+    return juce::var(result);
+}
+
+juce::var RpcBridge::handleSetTuningGroup(const juce::var& params)
+{
+    auto groupId = params.getProperty("group", juce::String()).toString();
+
+    if (groupId.length() > 64)
+        throw std::runtime_error("group id must be at most 64 characters");
+
+    processor.setTuningGroup(groupId);
+    return juce::var(true);
+}
+
+juce::var RpcBridge::handleSetPreset(const juce::var& params)
+{
+    auto index = static_cast<int>(params.getProperty("index", -1));
+
+    if (!juce::isPositiveAndBelow(index, TuningEngine::maxPresets))
+        throw std::runtime_error("index must be between 0 and " + std::to_string(TuningEngine::maxPresets - 1));
+
+    auto table = readCentsTable(params.getProperty("tuningTable", juce::var()));
+    processor.getTuningEngine().setPresetTable(index, table);
+    return juce::var(true);
+}
+
+juce::var RpcBridge::handleSelectPreset(const juce::var& params)
+{
+    auto index = static_cast<int>(params.getProperty("index", -1));
+
+    if (!juce::isPositiveAndBelow(index, TuningEngine::maxPresets))
+        throw std::runtime_error("index must be between 0 and " + std::to_string(TuningEngine::maxPresets - 1));
+
+    processor.getTuningEngine().selectPreset(index);
+    return juce::var(true);
+}
+
+juce::var RpcBridge::handleMorphTables(const juce::var& params)
+{
+    auto from = static_cast<int>(params.getProperty("from", -1));
+    auto to = static_cast<int>(params.getProperty("to", -1));
+    auto amount = static_cast<float>(params.getProperty("amount", 0.0f));
+    auto stretch = static_cast<float>(params.getProperty("stretch", 1.0f));
+    auto transposeCents = static_cast<float>(params.getProperty("transposeCents", 0.0f));
+
+    if (!processor.setTuningFromPresets(from, to, amount, stretch, transposeCents))
+        throw std::runtime_error("from and to must be between 0 and " + std::to_string(TuningEngine::maxPresets - 1));
+
+    return juce::var(true);
+}
+
+juce::var RpcBridge::handleTransformTable(const juce::var& params)
+{
+    auto source = static_cast<int>(params.getProperty("source", -1));
+    auto stretch = static_cast<float>(params.getProperty("stretch", 1.0f));
+    auto transposeCents = static_cast<float>(params.getProperty("transposeCents", 0.0f));
+
+    if (!processor.setTuningFromPresets(source, source, 0.0f, stretch, transposeCents))
+        throw std::runtime_error("source must be between 0 and " + std::to_string(TuningEngine::maxPresets - 1));
+
+    return juce::var(true);
+}
+
+juce::var RpcBridge::handleSetPresetSwitching(const juce::var& params)
+{
+    auto& engine = processor.getTuningEngine();
+
+    auto programChange = static_cast<bool>(params.getProperty("programChange", engine.getPresetSwitchesOnProgramChange()));
+    auto controller = static_cast<int>(params.getProperty("controller", engine.getPresetController()));
+
+    engine.setPresetSwitching(programChange, controller);
+    return juce::var(true);
+}
+
 juce::var RpcBridge::handleGetState(const juce::var&)
 {
+    // One copy, so the reply never mixes two edits
+    TuningEngine::SavedState state;
+    processor.getTuningEngine().copyState(state);
+
     auto result = new juce::DynamicObject();
     
-    result->setProperty("pitchBendRange", processor.getTuningEngine().getPitchBendRange());
+    result->setProperty("pitchBendRange", state.pitchBendRange);
+    result->setProperty("inputPitchBendRange", state.inputPitchBendRange);
     
-    auto& table = processor.getTuningEngine().getTuningTable();
+    const auto& table = state.presets[(size_t) state.selectedPreset];
     juce::Array<juce::var> tuningArray;
     for (int i = 0; i < 128; ++i)
-        tuningArray.add(table[i]);
+        tuningArray.add(table[(size_t) i]);
     result->setProperty("tuningTable", tuningArray);
 
+    auto nearestKey = state.noteMapping == TuningEngine::NoteMapping::nearestKey;
+    result->setProperty("noteMapping", nearestKey ? "nearestKey" : "sameKey");
+
+    static const char* const retuneNames[] = { "off", "immediate", "glide" };
+    result->setProperty("heldNoteRetune", retuneNames[static_cast<int>(state.heldNoteRetune)]);
+    result->setProperty("retuneGlideMs", state.retuneGlideMs);
+
+    const auto& allocation = state.voiceAllocation;
+    static const char* const modeNames[] = { "channel", "roundRobin", "mpeLower", "mpeUpper" };
+
+    auto voiceAllocation = new juce::DynamicObject();
+    voiceAllocation->setProperty("mode", modeNames[static_cast<int>(allocation.mode)]);
+    voiceAllocation->setProperty("firstChannel", allocation.firstChannel + 1);
+    voiceAllocation->setProperty("lastChannel", allocation.lastChannel + 1);
+    voiceAllocation->setProperty("memberChannels", allocation.numMemberChannels);
+    result->setProperty("voiceAllocation", juce::var(voiceAllocation));
+
+    result->setProperty("outputProtocol", protocolNames[static_cast<int>(state.outputProtocol)]);
+    result->setProperty("effectiveProtocol", protocolNames[static_cast<int>(processor.getEffectiveOutputProtocol())]);
+
+    auto group = new juce::DynamicObject();
+    group->setProperty("id", processor.getTuningGroup());
+    group->setProperty("members", TuningGroups::getNumMembers(processor.getTuningGroup()));
+    result->setProperty("tuningGroup", juce::var(group));
+
+    auto presets = new juce::DynamicObject();
+    presets->setProperty("current", state.selectedPreset);
+    presets->setProperty("count", TuningEngine::maxPresets);
+    presets->setProperty("programChange", state.presetProgramChange);
+    presets->setProperty("controller", state.presetController);
+    result->setProperty("presets", juce::var(presets));
+
+    auto strategy = state.retuningStrategy;
+    result->setProperty("dynamicTuning", strategy != nullptr ? strategy->getName() : juce::String("off"));
+
+    juce::Array<juce::var> frequencyArray;
+    for (int i = 0; i < state.numFrequencies; ++i)
+        frequencyArray.add(state.frequenciesHz[(size_t) i]);
+    result->setProperty("frequencySet", frequencyArray);
+
+    return juce::var(result);
+}
+
+juce::var RpcBridge::handleConfigureEvents(const juce::var& params)
+{
+    if (params.hasProperty("maxRate"))
+        eventBatcher.setMaxRate(params.getProperty("maxRate", 60));
+
+    if (params.hasProperty("maxQueueDepth"))
+        eventBatcher.setMaxQueueDepth(params.getProperty("maxQueueDepth", 1024));
+
+    return juce::var(true);
+}
+
+juce::var RpcBridge::handleGetEventStats(const juce::var&)
+{
+    auto metrics = eventBatcher.getMetrics();
+
+    auto result = new juce::DynamicObject();
+    result->setProperty("maxRate", eventBatcher.getMaxRate());
+    result->setProperty("queueDepth", metrics.queueDepth);
+    result->setProperty("maxQueueDepth", metrics.maxQueueDepth);
+    result->setProperty("eventsQueued", metrics.eventsQueued);
+    result->setProperty("eventsCoalesced", metrics.eventsCoalesced);
+    result->setProperty("eventsDropped", metrics.eventsDropped);
+    result->setProperty("flushes", metrics.flushes);
+    return juce::var(result);
+}
+
+juce::var RpcBridge::handleGetStats(const juce::var&)
+{
+    auto result = new juce::DynamicObject();
+    result->setProperty("enabled", BlockStats::enabled);
+
+    if (BlockStats::enabled)
+    {
+        const auto& stats = processor.getBlockStats();
+        auto& engine = processor.getTuningEngine();
+
+        // Times in microseconds, load in percent of each block's duration
+        result->setProperty("blockMicros", toVar(stats.getEngineTime()));
+        result->setProperty("loadPercent", toVar(stats.getLoad()));
+        result->setProperty("eventsIn", toVar(stats.getEventsIn()));
+        result->setProperty("eventsOut", toVar(stats.getEventsOut()));
+        result->setProperty("hostedMicros", toVar(stats.getHostedTime()));
+        result->setProperty("hostedBlocksSkipped", stats.getHostedBlocksSkipped());
+        result->setProperty("bendsSent", engine.getNumBendsSent());
+        result->setProperty("voiceSteals", engine.getNumVoiceSteals());
+        result->setProperty("telemetryDropped", engine.getTelemetry().getNumDropped());
+        result->setProperty("outputReallocations", engine.getNumOutputReallocations());
+    }
+
     return juce::var(result);
 }
 
+juce::var RpcBridge::handleStartCapture(const juce::var& params)
+{
+    auto path = params.getProperty("path", juce::String()).toString();
+    juce::File file;
+
+    if (path.isEmpty())
+    {
+        auto folder = juce::File::getSpecialLocation(juce::File::userDocumentsDirectory)
+                          .getChildFile("TuningMiddleware").getChildFile("Captures");
+        folder.createDirectory();
+        file = folder.getChildFile("capture-" + juce::Time::getCurrentTime().formatted("%Y%m%d-%H%M%S") + ".tmcap");
+    }
+    else if (juce::File::isAbsolutePath(path))
+    {
+        file = juce::File(path);
+    }
+    else
+    {
+        throw std::runtime_error("capture path must be absolute");
+    }
+
+    // Replays render packets only if the session had somewhere to send them
+    juce::String error;
+
+    if (! processor.getMidiCapture().start(file, processor.getSampleRate(), processor.getBlockSize(),
+                                           processor.hasUmpDestination(), error))
+        throw std::runtime_error(("can't start capture: " + error).toStdString());
+
+    return toVar(processor.getMidiCapture().getStatus());
+}
+
+juce::var RpcBridge::handleStopCapture(const juce::var&)
+{
+    return toVar(processor.getMidiCapture().stop());
+}
+
+juce::var RpcBridge::handleSaveState(const juce::var& params)
+{
+    auto path = params.getProperty("path", juce::String()).toString();
+    juce::File file;
+
+    if (path.isEmpty())
+    {
+        auto folder = juce::File::getSpecialLocation(juce::File::userDocumentsDirectory)
+                          .getChildFile("TuningMiddleware").getChildFile("States");
+        folder.createDirectory();
+        file = folder.getChildFile("tuning-" + juce::Time::getCurrentTime().formatted("%Y%m%d-%H%M%S") + ".tmst");
+    }
+    else if (juce::File::isAbsolutePath(path))
+    {
+        file = juce::File(path);
+    }
+    else
+    {
+        throw std::runtime_error("state path must be absolute");
+    }
+
+    // The engine's chunks only, for TuningMiddlewareBatch
+    TuningEngine::SavedState engineState;
+    processor.getTuningEngine().copyState(engineState);
+
+    juce::MemoryBlock state;
+
+    {
+        StateFormat::Writer writer(state);
+        StateFormat::writeTuningEngine(writer, engineState);
+    }
+
+    if (! file.replaceWithData(state.getData(), state.getSize()))
+        throw std::runtime_error(("can't write " + file.getFullPathName()).toStdString());
+
+    auto result = new juce::DynamicObject();
+    result->setProperty("path", file.getFullPathName());
+    return juce::var(result);
+}
+
+juce::var RpcBridge::handleRegisterMts(const juce::var&)
+{
+    // Succeeds again once a master that held the session has gone
+    auto& master = processor.getMtsEspMaster();
+
+    auto result = new juce::DynamicObject();
+    result->setProperty("active", master.registerMaster());
+    result->setProperty("clients", master.getClientCount());
+    return juce::var(result);
+}
+
+juce::var RpcBridge::handleBroadcastMts(const juce::var& params)
+{
+    auto frequencyArray = params.getProperty("tuningTable", juce::var());
+
+    if (!frequencyArray.isArray() || frequencyArray.size() != 128)
+        throw std::runtime_error("tuningTable must be an array of 128 frequencies in Hz");
+
+    std::array<double, 128> frequencies;
+    for (int i = 0; i < 128; ++i)
+    {
+        frequencies[(size_t) i] = static_cast<double>(frequencyArray[i]);
+
+        if (!(frequencies[(size_t) i] > 0.0) || !std::isfinite(frequencies[(size_t) i]))
+            throw std::runtime_error("tuningTable frequencies must be positive");
+    }
+
+    // Held until the engine's next edit, which is broadcast in its place
+    processor.getMtsEspMaster().setNoteTunings(frequencies.data());
+    return juce::var(processor.getMtsEspMaster().isActive());
+}
+
+juce::var RpcBridge::handleGetMtsClientCount(const juce::var&)
+{
+    return juce::var(processor.getMtsEspMaster().getClientCount());
+}
+
+juce::var RpcBridge::handleScanPlugins(const juce::var&)
+{
+    // The cached list answers straight away; the scan refreshes it in the background
+    processor.getPluginScanner().startScan();
+    return getKnownPlugins();
+}
+
+juce::var RpcBridge::getKnownPlugins()
+{
+    juce::Array<juce::var> plugins;
+
+    for (const auto& type : processor.getPluginScanner().getKnownPlugins().getTypes())
+        plugins.add(toVar(type));
+
+    return plugins;
+}
+
+void RpcBridge::sendPluginScanProgress(const PluginScanner::Progress& progress)
+{
+    auto params = new juce::DynamicObject();
+    params->setProperty("format", progress.formatName);
+    params->setProperty("current", progress.currentPlugin);
+    params->setProperty("progress", progress.progress);
+    params->setProperty("found", progress.numFound);
+    params->setProperty("finished", progress.finished);
+
+    if (progress.finished)
+        params->setProperty("plugins", getKnownPlugins());
+
+    sendEvent("event.pluginScan", juce::var(params));
+}
+
+juce::var RpcBridge::handleLoadPlugin(const juce::var& params)
+{
+    auto path = params.getProperty("path", juce::String()).toString();
+
+    if (path.isEmpty())
+        throw std::runtime_error("path must name a plugin file or identifier");
+
+    // One plugin is hosted at a time, so this replaces any other once it is ready
+    auto id = processor.loadPlugin(path);
+
+    if (id.isEmpty())
+        throw std::runtime_error(("no plugin found for " + path).toStdString());
+
+    auto result = new juce::DynamicObject();
+    result->setProperty("id", id);
+    return juce::var(result);
+}
+
+juce::var RpcBridge::handleUnloadPlugin(const juce::var&)
+{
+    processor.unloadPlugin();
+    return juce::var(true);
+}
+
 void RpcBridge::sendEvent(const juce::String& method, const juce::var& params)
 {
-    if (!eventCallback)
-        return;
+    eventBatcher.enqueue(createEvent(method, params));
+}
 
+void RpcBridge::sendStateEvent(const juce::String& method, const juce::var& params)
+{
+    eventBatcher.enqueueState(method, createEvent(method, params));
+}
+
+juce::var RpcBridge::createEvent(const juce::String& method, const juce::var& params)
+{
     auto event = new juce::DynamicObject();
     event->setProperty("jsonrpc", "2.0");
     event->setProperty("method", method);
     event->setProperty("params", params);
-
-    eventCallback(juce::JSON::toString(juce::var(event)));
+    return juce::var(event);
 }
 
 juce::String RpcBridge::createResponse(int id, const juce::var& result)
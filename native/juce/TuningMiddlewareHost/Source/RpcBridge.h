@@ -1,6 +1,8 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "EventBatcher.h"
+#include "PluginScanner.h"
 
 class TuningMiddlewareHostProcessor;
 
@@ -16,19 +18,62 @@ public:
     // Handle incoming JSON-RPC request from WebView
     juce::String handleRequest(const juce::String& jsonRequest);
 
-    // Send event to WebView
+    // Send events to WebView. They are batched, and the callback receives a JSON
+    // array of events at most once per frame.
     using EventCallback = std::function<void(const juce::String&)>;
-    void setEventCallback(EventCallback callback) { eventCallback = callback; }
+    void setEventCallback(EventCallback callback) { eventBatcher.setFlushCallback(std::move(callback)); }
     void sendEvent(const juce::String& method, const juce::var& params);
 
+    // Like sendEvent, but an undelivered event with the same method is replaced
+    void sendStateEvent(const juce::String& method, const juce::var& params);
+
+    EventBatcher& getEventBatcher() { return eventBatcher; }
+
+    // Forwards a scan report as event.pluginScan; the final one lists every known plugin
+    void sendPluginScanProgress(const PluginScanner::Progress& progress);
+
+    // Same object as the getState method returns, for pushing to a reattached page
+    juce::var getStateSnapshot() { return handleGetState({}); }
+
 private:
     TuningMiddlewareHostProcessor& processor;
-    EventCallback eventCallback;
+    EventBatcher eventBatcher;
+
+    // Binary frames (see TuningCodec) bypass JSON parsing entirely
+    juce::String handleBinaryRequest(const juce::String& frameText);
 
     // RPC method handlers
     juce::var handleSetTuning(const juce::var& params);
     juce::var handleSetPitchBendRange(const juce::var& params);
+    juce::var handleSetInputPitchBendRange(const juce::var& params);
+    juce::var handleSetNoteMapping(const juce::var& params);
+    juce::var handleSetHeldNoteRetune(const juce::var& params);
+    juce::var handleSetVoiceAllocation(const juce::var& params);
+    juce::var handleSetFrequencySet(const juce::var& params);
+    juce::var handleSetDynamicTuning(const juce::var& params);
+    juce::var handleSetOutputProtocol(const juce::var& params);
+    juce::var handleSetTuningGroup(const juce::var& params);
+    juce::var handleSetPreset(const juce::var& params);
+    juce::var handleSelectPreset(const juce::var& params);
+    juce::var handleMorphTables(const juce::var& params);
+    juce::var handleTransformTable(const juce::var& params);
+    juce::var handleSetPresetSwitching(const juce::var& params);
     juce::var handleGetState(const juce::var& params);
+    juce::var handleConfigureEvents(const juce::var& params);
+    juce::var handleGetEventStats(const juce::var& params);
+    juce::var handleGetStats(const juce::var& params);
+    juce::var handleStartCapture(const juce::var& params);
+    juce::var handleStopCapture(const juce::var& params);
+    juce::var handleSaveState(const juce::var& params);
+    juce::var handleRegisterMts(const juce::var& params);
+    juce::var handleBroadcastMts(const juce::var& params);
+    juce::var handleGetMtsClientCount(const juce::var& params);
+    juce::var handleScanPlugins(const juce::var& params);
+    juce::var handleLoadPlugin(const juce::var& params);
+    juce::var handleUnloadPlugin(const juce::var& params);
+
+    static juce::var createEvent(const juce::String& method, const juce::var& params);
+    juce::var getKnownPlugins();
 
     // JSON helpers
     juce::String createResponse(int id, const juce::var& result);
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <atomic>
+
+/**
+ * SharedTable - A tuning table published by one thread at a time and read by many
+ *
+ * Each publish() builds an immutable snapshot and swaps it in with one atomic
+ * exchange, so an edit costs the same however many engines play the table.
+ * Readers, audio threads included, copy the current snapshot without locking or
+ * allocating. A replaced snapshot is freed by a later publish, once no read is
+ * in progress.
+ */
+class SharedTable : public juce::ReferenceCountedObject
+{
+public:
+    using Ptr = juce::ReferenceCountedObjectPtr<SharedTable>;
+
+    explicit SharedTable(const std::array<float, 128>& cents) { publish(cents); }
+    ~SharedTable() override { delete current.load(); }
+
+    // Any non-audio thread
+    void publish(const std::array<float, 128>& cents)
+    {
+        auto snapshot = std::make_unique<Snapshot>();
+        snapshot->cents = cents;
+
+        const juce::ScopedLock lock(publishLock);
+        snapshot->serial = lastSerial.fetch_add(1) + 1;
+        auto serial = snapshot->serial;
+
+        if (auto* previous = current.exchange(snapshot.release()))
+            retired.add(previous);
+
+        publishedSerial.store(serial, std::memory_order_release);
+
+        // A read that could have loaded a retired snapshot announced itself before
+        // the exchange, so with none in progress nothing still holds one
+        if (readers.load() == 0)
+            retired.clear();
+    }
+
+    // Copies the table when it was published after lastReadSerial, which it then
+    // updates; false when there is nothing new. Any thread.
+    bool readIfChanged(juce::uint32& lastReadSerial, std::array<float, 128>& cents) const noexcept
+    {
+        if (publishedSerial.load(std::memory_order_acquire) == lastReadSerial)
+            return false;
+
+        readers.fetch_add(1);
+        const auto* snapshot = current.load();
+        cents = snapshot->cents;
+        lastReadSerial = snapshot->serial;
+        readers.fetch_sub(1);
+        return true;
+    }
+
+    void read(std::array<float, 128>& cents) const noexcept
+    {
+        juce::uint32 serial = 0;
+        readIfChanged(serial, cents);
+    }
+
+    // Serials are unique across tables, so a reader switching tables sees a change
+    juce::uint32 getSerial() const noexcept { return publishedSerial.load(std::memory_order_acquire); }
+
+private:
+    struct Snapshot
+    {
+        std::array<float, 128> cents {};
+        juce::uint32 serial = 0;
+    };
+
+    std::atomic<Snapshot*> current { nullptr };
+    std::atomic<juce::uint32> publishedSerial { 0 };
+    mutable std::atomic<int> readers { 0 };
+
+    juce::CriticalSection publishLock;
+    juce::OwnedArray<Snapshot> retired;
+
+    // Shared by every table, and never 0, which readers start from
+    static inline std::atomic<juce::uint32> lastSerial { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SharedTable)
+};
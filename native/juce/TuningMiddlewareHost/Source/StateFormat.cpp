@@ -0,0 +1,497 @@
+#include "StateFormat.h"
+#include "TuningEngine.h"
+
+namespace StateFormat
+{
+namespace
+{
+    constexpr size_t fileHeaderBytes = 8;
+    constexpr size_t chunkHeaderBytes = 8;
+
+    enum class TableEncoding : juce::uint8
+    {
+        raw = 0,
+        sparse = 1
+    };
+
+    // Cursor over a chunk payload; every read is bounds-checked
+    struct PayloadReader
+    {
+        const juce::uint8* data;
+        size_t size;
+        size_t position = 0;
+
+        bool canRead(size_t numBytes) const { return numBytes <= size - position; }
+
+        juce::uint8 readByte() { return data[position++]; }
+
+        juce::uint16 readUint16()
+        {
+            auto value = juce::ByteOrder::littleEndianShort(data + position);
+            position += 2;
+            return value;
+        }
+
+        juce::uint32 readUint32()
+        {
+            auto value = juce::ByteOrder::littleEndianInt(data + position);
+            position += 4;
+            return value;
+        }
+
+        float readFloat()
+        {
+            auto bits = readUint32();
+            float value;
+            std::memcpy(&value, &bits, sizeof(value));
+            return value;
+        }
+
+        double readDouble()
+        {
+            auto bits = juce::ByteOrder::littleEndianInt64(data + position);
+            position += 8;
+            double value;
+            std::memcpy(&value, &bits, sizeof(value));
+            return value;
+        }
+    };
+}
+
+//==============================================================================
+Writer::Writer(juce::MemoryBlock& dest)
+    : stream(dest, true)
+{
+    stream.writeInt((int) magic);
+    stream.writeShort((short) version);
+    stream.writeShort(0);
+}
+
+Writer::~Writer()
+{
+    jassert(sizeFieldPosition < 0); // beginChunk() without endChunk()
+    stream.flush();
+}
+
+juce::MemoryOutputStream& Writer::beginChunk(juce::uint32 id)
+{
+    jassert(sizeFieldPosition < 0);
+
+    stream.writeInt((int) id);
+    sizeFieldPosition = stream.getPosition();
+    stream.writeInt(0); // patched by endChunk()
+    return stream;
+}
+
+void Writer::endChunk()
+{
+    jassert(sizeFieldPosition >= 0);
+
+    auto end = stream.getPosition();
+    auto payloadSize = end - sizeFieldPosition - 4;
+
+    stream.setPosition(sizeFieldPosition);
+    stream.writeInt((int) payloadSize);
+    stream.setPosition(end);
+
+    sizeFieldPosition = -1;
+}
+
+void Writer::addChunk(juce::uint32 id, const void* data, size_t numBytes)
+{
+    beginChunk(id).write(data, numBytes);
+    endChunk();
+}
+
+//==============================================================================
+Reader::Reader(const void* sourceData, size_t sourceSize)
+    : data(static_cast<const juce::uint8*>(sourceData)),
+      numBytes(sourceData != nullptr ? sourceSize : 0)
+{
+    if (numBytes < fileHeaderBytes || juce::ByteOrder::littleEndianInt(data) != magic)
+        return;
+
+    // Minor additions come as new chunks; a newer version may change existing ones
+    valid = juce::ByteOrder::littleEndianShort(data + 4) <= version;
+    position = fileHeaderBytes;
+}
+
+bool Reader::next(Chunk& chunk)
+{
+    if (!valid || numBytes - position < chunkHeaderBytes)
+        return false;
+
+    auto id = juce::ByteOrder::littleEndianInt(data + position);
+    auto size = (size_t) juce::ByteOrder::littleEndianInt(data + position + 4);
+
+    if (size > numBytes - position - chunkHeaderBytes)
+    {
+        jassertfalse; // truncated state
+        position = numBytes;
+        return false;
+    }
+
+    chunk.id = id;
+    chunk.data = data + position + chunkHeaderBytes;
+    chunk.size = size;
+
+    position += chunkHeaderBytes + size;
+    return true;
+}
+
+//==============================================================================
+static int countDetunedNotes(const std::array<float, 128>& table)
+{
+    int numNonZero = 0;
+    for (auto cents : table)
+        if (cents != 0.0f)
+            ++numNonZero;
+
+    return numNonZero;
+}
+
+static void writeTable(juce::MemoryOutputStream& stream, const std::array<float, 128>& table)
+{
+    auto numNonZero = countDetunedNotes(table);
+
+    // 5 bytes per detuned note against 4 per note for the full table
+    if (1 + numNonZero * 5 < (int) table.size() * 4)
+    {
+        stream.writeByte((char) TableEncoding::sparse);
+        stream.writeByte((char) numNonZero);
+
+        for (int note = 0; note < (int) table.size(); ++note)
+        {
+            if (table[(size_t) note] != 0.0f)
+            {
+                stream.writeByte((char) note);
+                stream.writeFloat(table[(size_t) note]);
+            }
+        }
+    }
+    else
+    {
+        stream.writeByte((char) TableEncoding::raw);
+
+        for (auto cents : table)
+            stream.writeFloat(cents);
+    }
+}
+
+static bool readTable(PayloadReader& reader, std::array<float, 128>& table)
+{
+    if (!reader.canRead(1))
+        return false;
+
+    auto encoding = (TableEncoding) reader.readByte();
+
+    // Decoded aside, so a rejected table leaves the one already read alone
+    std::array<float, 128> decoded {};
+
+    if (encoding == TableEncoding::raw)
+    {
+        if (!reader.canRead(decoded.size() * 4))
+            return false;
+
+        for (auto& cents : decoded)
+            cents = reader.readFloat();
+    }
+    else if (encoding == TableEncoding::sparse)
+    {
+        if (!reader.canRead(1))
+            return false;
+
+        auto count = (size_t) reader.readByte();
+        if (!reader.canRead(count * 5))
+            return false;
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            auto note = reader.readByte();
+            auto cents = reader.readFloat();
+
+            if (note < decoded.size())
+                decoded[note] = cents;
+        }
+    }
+    else
+    {
+        return false;
+    }
+
+    // NaN or inf would pass every range check on the way to the bends
+    if (! std::all_of(decoded.begin(), decoded.end(), [](float cents) { return std::isfinite(cents); }))
+        return false;
+
+    table = decoded;
+    return true;
+}
+
+void writeTuningEngine(Writer& writer, const TuningEngine::SavedState& state)
+{
+    static_assert(EngineState::maxPresets == TuningEngine::maxPresets, "preset bank sizes differ");
+
+    auto selected = state.selectedPreset;
+
+    writeTable(writer.beginChunk(tuningChunk), state.presets[(size_t) selected]);
+    writer.endChunk();
+
+    for (int index = 0; index < TuningEngine::maxPresets; ++index)
+    {
+        auto& table = state.presets[(size_t) index];
+
+        if (index == selected || countDetunedNotes(table) == 0)
+            continue;
+
+        auto& preset = writer.beginChunk(presetChunk);
+        preset.writeByte((char) index);
+        writeTable(preset, table);
+        writer.endChunk();
+    }
+
+    auto& selection = writer.beginChunk(presetSelectionChunk);
+    selection.writeByte((char) selected);
+    selection.writeByte(state.presetProgramChange ? 1 : 0);
+    selection.writeByte((char) (state.presetController >= 0 ? state.presetController : 255));
+    writer.endChunk();
+
+    if (state.numFrequencies > 0)
+    {
+        auto& frequencySet = writer.beginChunk(frequencySetChunk);
+        frequencySet.writeShort((short) state.numFrequencies);
+
+        for (int i = 0; i < state.numFrequencies; ++i)
+            frequencySet.writeDouble(state.frequenciesHz[(size_t) i]);
+
+        writer.endChunk();
+    }
+
+    if (state.retuningStrategy != nullptr)
+    {
+        auto strategyName = state.retuningStrategy->getName();
+        writer.addChunk(dynamicTuningChunk, strategyName.toRawUTF8(), strategyName.getNumBytesAsUTF8());
+    }
+
+    const auto& allocation = state.voiceAllocation;
+
+    auto& settings = writer.beginChunk(engineChunk);
+    settings.writeFloat(state.pitchBendRange);
+    settings.writeByte((char) state.noteMapping);
+    settings.writeByte((char) state.heldNoteRetune);
+    settings.writeFloat(state.retuneGlideMs);
+    settings.writeByte((char) allocation.mode);
+    settings.writeByte((char) allocation.firstChannel);
+    settings.writeByte((char) allocation.lastChannel);
+    settings.writeByte((char) allocation.numMemberChannels);
+    settings.writeByte((char) state.outputProtocol);
+    settings.writeFloat(state.inputPitchBendRange);
+    writer.endChunk();
+}
+
+bool readTuningEngineChunk(const Chunk& chunk, EngineState& state)
+{
+    PayloadReader reader { chunk.data, chunk.size };
+
+    if (chunk.id == tuningChunk)
+        return readTable(reader, state.cents);
+
+    if (chunk.id == presetChunk)
+    {
+        if (!reader.canRead(1))
+            return false;
+
+        auto index = (int) reader.readByte();
+        if (!juce::isPositiveAndBelow(index, EngineState::maxPresets))
+            return false;
+
+        return readTable(reader, state.presets[(size_t) index]);
+    }
+
+    if (chunk.id == presetSelectionChunk)
+    {
+        if (!reader.canRead(3))
+            return false;
+
+        state.selectedPreset = reader.readByte();
+        state.presetProgramChange = reader.readByte() != 0;
+
+        auto controller = (int) reader.readByte();
+        state.presetController = controller < 128 ? controller : -1;
+        return true;
+    }
+
+    if (chunk.id == frequencySetChunk)
+    {
+        if (!reader.canRead(2))
+            return false;
+
+        auto count = (size_t) reader.readUint16();
+        if (count > (size_t) TuningEngine::maxFrequencies || !reader.canRead(count * 8))
+            return false;
+
+        state.frequencies.clearQuick();
+        for (size_t i = 0; i < count; ++i)
+            state.frequencies.add(reader.readDouble());
+
+        return true;
+    }
+
+    if (chunk.id == dynamicTuningChunk)
+    {
+        state.retuningStrategy = juce::String::fromUTF8(reinterpret_cast<const char*>(chunk.data), (int) chunk.size);
+        return true;
+    }
+
+    if (chunk.id == engineChunk)
+    {
+        if (!reader.canRead(14))
+            return false;
+
+        auto pitchBendRange = reader.readFloat();
+        auto noteMapping = (int) reader.readByte();
+        auto heldNoteRetune = (int) reader.readByte();
+        auto retuneGlideMs = reader.readFloat();
+
+        if (! std::isfinite(pitchBendRange) || ! std::isfinite(retuneGlideMs))
+            return false;
+
+        state.pitchBendRange = pitchBendRange;
+        state.noteMapping = noteMapping;
+        state.heldNoteRetune = heldNoteRetune;
+        state.retuneGlideMs = retuneGlideMs;
+        state.allocationMode = reader.readByte();
+        state.firstChannel = reader.readByte();
+        state.lastChannel = reader.readByte();
+        state.numMemberChannels = reader.readByte();
+
+        // Added after the first release; older states end here
+        if (reader.canRead(1))
+            state.outputProtocol = reader.readByte();
+
+        if (reader.canRead(4))
+        {
+            auto inputPitchBendRange = reader.readFloat();
+
+            if (std::isfinite(inputPitchBendRange))
+                state.inputPitchBendRange = inputPitchBendRange;
+        }
+
+        state.hasSettings = true;
+        return true;
+    }
+
+    return false;
+}
+
+bool readLegacyTuningEngine(const void* data, size_t size, EngineState& state)
+{
+    if (size != 129 * sizeof(float))
+        return false;
+
+    juce::MemoryInputStream stream(data, size, false);
+    std::array<float, 128> cents;
+
+    for (auto& value : cents)
+        value = stream.readFloat();
+
+    auto pitchBendRange = stream.readFloat();
+
+    // Rejected like the chunked tables are
+    if (! std::isfinite(pitchBendRange) || ! std::all_of(cents.begin(), cents.end(), [](float value) { return std::isfinite(value); }))
+        return false;
+
+    state.cents = cents;
+    state.pitchBendRange = pitchBendRange;
+    return true;
+}
+
+void restoreTuningEngine(const EngineState& state, TuningEngine& engine)
+{
+    TuningEngine::SavedState saved;
+
+    if (state.hasSettings)
+    {
+        // Out-of-range values from a damaged or hand-edited state fall back to defaults
+        saved.noteMapping = state.noteMapping == (int) TuningEngine::NoteMapping::nearestKey
+                                ? TuningEngine::NoteMapping::nearestKey
+                                : TuningEngine::NoteMapping::sameKey;
+
+        saved.heldNoteRetune = state.heldNoteRetune <= (int) TuningEngine::HeldNoteRetune::glide
+                                   ? (TuningEngine::HeldNoteRetune) state.heldNoteRetune
+                                   : TuningEngine::HeldNoteRetune::off;
+        saved.retuneGlideMs = state.retuneGlideMs;
+
+        if (state.allocationMode <= (int) VoiceAllocator::Mode::mpeUpperZone)
+        {
+            auto& allocation = saved.voiceAllocation;
+            allocation.mode = (VoiceAllocator::Mode) state.allocationMode;
+            allocation.firstChannel = juce::jlimit(0, 15, state.firstChannel);
+            allocation.lastChannel = juce::jlimit(allocation.firstChannel, 15, state.lastChannel);
+            allocation.numMemberChannels = juce::jlimit(1, 15, state.numMemberChannels);
+        }
+
+        saved.outputProtocol = state.outputProtocol <= (int) TuningEngine::OutputProtocol::midi2PerNoteBend
+                                   ? (TuningEngine::OutputProtocol) state.outputProtocol
+                                   : TuningEngine::OutputProtocol::midi1;
+
+        saved.inputPitchBendRange = state.inputPitchBendRange;
+    }
+    else
+    {
+        // A table-only state leaves the engine's settings as they are
+        engine.copyState(saved);
+    }
+
+    // The selected preset's table is saved on its own, as the table that plays
+    saved.selectedPreset = juce::isPositiveAndBelow(state.selectedPreset, TuningEngine::maxPresets) ? state.selectedPreset : 0;
+    saved.presets = state.presets;
+    saved.presets[(size_t) saved.selectedPreset] = state.cents;
+
+    saved.presetProgramChange = state.presetProgramChange;
+    saved.presetController = state.presetController;
+    saved.numFrequencies = juce::jmin(state.frequencies.size(), TuningEngine::maxFrequencies);
+    std::copy(state.frequencies.begin(), state.frequencies.begin() + saved.numFrequencies, saved.frequenciesHz.begin());
+    std::sort(saved.frequenciesHz.begin(), saved.frequenciesHz.begin() + saved.numFrequencies);
+    saved.retuningStrategy = RetuningStrategy::create(state.retuningStrategy);
+    saved.pitchBendRange = state.pitchBendRange;
+
+    engine.restoreState(saved);
+}
+
+//==============================================================================
+void writePlugin(Writer& writer, const juce::String& pluginId, const juce::MemoryBlock& state)
+{
+    auto& stream = writer.beginChunk(pluginChunk);
+
+    auto id = pluginId.toRawUTF8();
+    auto idBytes = std::strlen(id);
+
+    stream.writeInt((int) idBytes);
+    stream.write(id, idBytes);
+    stream.write(state.getData(), state.getSize());
+
+    writer.endChunk();
+}
+
+bool readPluginChunk(const Chunk& chunk, juce::String& pluginId, const juce::uint8*& state, size_t& stateSize)
+{
+    if (chunk.id != pluginChunk)
+        return false;
+
+    PayloadReader reader { chunk.data, chunk.size };
+
+    if (!reader.canRead(4))
+        return false;
+
+    auto idBytes = (size_t) reader.readUint32();
+    if (!reader.canRead(idBytes))
+        return false;
+
+    pluginId = juce::String::fromUTF8(reinterpret_cast<const char*>(chunk.data + reader.position), (int) idBytes);
+    reader.position += idBytes;
+
+    state = chunk.data + reader.position;
+    stateSize = chunk.size - reader.position;
+    return true;
+}
+}
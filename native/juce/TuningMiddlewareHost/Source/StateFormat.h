@@ -0,0 +1,149 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include "TuningEngine.h"
+
+/**
+ * StateFormat - Chunked binary layout shared by both processors' saved state
+ *
+ * Layout (little endian):
+ *   u32 magic 'TMST', u16 version, u16 reserved, then chunks of
+ *   u32 id, u32 size, size bytes of payload.
+ *
+ * Readers skip chunk ids they don't know, so new chunks can be added without a
+ * version bump. Chunks are read in place, without copying.
+ *
+ * Chunks:
+ *   'TUNE'  the selected preset's table: u8 encoding, then raw (128 x f32 cents) or
+ *           sparse (u8 count, count x (u8 note, f32 cents), every other note 0).
+ *   'PRST'  u8 preset index, then a table encoded as in 'TUNE'. One per
+ *           preset other than the selected one, skipped for 12TET presets.
+ *   'PSEL'  u8 selected preset, u8 program change switches (0/1),
+ *           u8 switching controller (255 for none).
+ *   'FREQ'  u16 count, count x f64 Hz. Only written while a frequency set is in use.
+ *   'DYNT'  retuning strategy name (UTF-8). Only written while one is active.
+ *   'ENGN'  f32 bend range, u8 note mapping, u8 held-note retune, f32 glide ms,
+ *           u8 allocation mode, u8 first channel, u8 last channel, u8 members,
+ *           u8 output protocol, f32 input bend range (both absent in older states).
+ *   'PLUG'  u32 id length, id (UTF-8), then the hosted plugin's own state bytes.
+ *   'GRUP'  tuning group id (UTF-8). Only written while in a group.
+ *
+ * The sparse table is used when it is shorter. Near-12TET tables and presets that
+ * differ in a few notes stay small, and they diff well between saves.
+ */
+namespace StateFormat
+{
+    constexpr juce::uint32 makeId(char a, char b, char c, char d)
+    {
+        return (juce::uint32) (juce::uint8) a
+             | ((juce::uint32) (juce::uint8) b << 8)
+             | ((juce::uint32) (juce::uint8) c << 16)
+             | ((juce::uint32) (juce::uint8) d << 24);
+    }
+
+    constexpr juce::uint32 magic = makeId('T', 'M', 'S', 'T');
+    constexpr juce::uint16 version = 1;
+
+    constexpr juce::uint32 tuningChunk = makeId('T', 'U', 'N', 'E');
+    constexpr juce::uint32 presetChunk = makeId('P', 'R', 'S', 'T');
+    constexpr juce::uint32 presetSelectionChunk = makeId('P', 'S', 'E', 'L');
+    constexpr juce::uint32 frequencySetChunk = makeId('F', 'R', 'E', 'Q');
+    constexpr juce::uint32 dynamicTuningChunk = makeId('D', 'Y', 'N', 'T');
+    constexpr juce::uint32 engineChunk = makeId('E', 'N', 'G', 'N');
+    constexpr juce::uint32 pluginChunk = makeId('P', 'L', 'U', 'G');
+    constexpr juce::uint32 tuningGroupChunk = makeId('G', 'R', 'U', 'P');
+
+    // A view into the caller's data; valid only as long as that data is
+    struct Chunk
+    {
+        juce::uint32 id = 0;
+        const juce::uint8* data = nullptr;
+        size_t size = 0;
+    };
+
+    class Writer
+    {
+    public:
+        // Appends to dest, which is usually empty
+        explicit Writer(juce::MemoryBlock& dest);
+        ~Writer();
+
+        // Everything written to the returned stream until endChunk() is the payload
+        juce::MemoryOutputStream& beginChunk(juce::uint32 id);
+        void endChunk();
+
+        void addChunk(juce::uint32 id, const void* data, size_t numBytes);
+
+    private:
+        juce::MemoryOutputStream stream;
+        juce::int64 sizeFieldPosition = -1;
+
+        JUCE_DECLARE_NON_COPYABLE(Writer)
+    };
+
+    class Reader
+    {
+    public:
+        Reader(const void* data, size_t numBytes);
+
+        // False if the header is missing or from a newer major version
+        bool isValid() const { return valid; }
+
+        // Steps to the next chunk. Returns false at the end, or when a chunk runs
+        // past the end of the data (the rest is then ignored).
+        bool next(Chunk& chunk);
+
+    private:
+        const juce::uint8* data;
+        size_t numBytes;
+        size_t position = 0;
+        bool valid = false;
+    };
+
+    // Tuning engine settings, shared by both processors
+    struct EngineState
+    {
+        static constexpr int maxPresets = 16;   // matches TuningEngine::maxPresets
+
+        // The selected preset's table; the others are in presets
+        std::array<float, 128> cents {};
+        std::array<std::array<float, 128>, maxPresets> presets {};
+        int selectedPreset = 0;
+        bool presetProgramChange = true;
+        int presetController = -1;
+
+        juce::Array<double> frequencies;   // Hz; empty for table tuning
+        juce::String retuningStrategy;     // empty for static tuning
+
+        float pitchBendRange = 48.0f;
+        int noteMapping = 0;
+        int heldNoteRetune = 0;
+        float retuneGlideMs = 20.0f;
+        int allocationMode = 0;
+        int firstChannel = 0;
+        int lastChannel = 15;
+        int numMemberChannels = 15;
+        int outputProtocol = 0;
+        float inputPitchBendRange = 2.0f;
+
+        bool hasSettings = false;   // false when only a table was saved
+    };
+
+    // Writes a copy taken with TuningEngine::copyState(), so the chunks agree
+    void writeTuningEngine(Writer& writer, const TuningEngine::SavedState& state);
+
+    // Consumes 'TUNE', 'PRST', 'PSEL', 'FREQ', 'DYNT' and 'ENGN' chunks; false for other ids or malformed ones
+    bool readTuningEngineChunk(const Chunk& chunk, EngineState& state);
+
+    // Sessions saved before the chunked format are 128 cents values and the bend
+    // range as little-endian floats; false for data of any other size
+    bool readLegacyTuningEngine(const void* data, size_t size, EngineState& state);
+
+    // Applies the whole state as one engine edit; settings are kept when only a table was saved
+    void restoreTuningEngine(const EngineState& state, TuningEngine& engine);
+
+    // Hosted plugin state is stored as raw bytes after its id
+    void writePlugin(Writer& writer, const juce::String& pluginId, const juce::MemoryBlock& state);
+    bool readPluginChunk(const Chunk& chunk, juce::String& pluginId, const juce::uint8*& state, size_t& stateSize);
+}
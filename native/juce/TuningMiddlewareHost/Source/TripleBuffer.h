@@ -0,0 +1,52 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <atomic>
+
+/**
+ * TripleBuffer - Wait-free hand-over of a value from one writer to one reader
+ *
+ * The writer fills a private back slot and publishes it with a single atomic
+ * exchange; the reader picks up the newest published slot the same way. Neither
+ * side blocks or allocates, and slots are recycled without any reclamation step.
+ */
+template <typename Type>
+class TripleBuffer
+{
+public:
+    TripleBuffer() = default;
+
+    // Writer side: fill the returned slot completely, then publish it
+    Type& getWriteBuffer() { return slots[(size_t) backIndex]; }
+
+    void publish()
+    {
+        auto previous = middleIndex.exchange(backIndex | freshFlag, std::memory_order_acq_rel);
+        backIndex = previous & indexMask;
+    }
+
+    // Reader side: adopt the newest published value, returns true if it changed
+    bool acquire()
+    {
+        if ((middleIndex.load(std::memory_order_relaxed) & freshFlag) == 0)
+            return false;
+
+        auto previous = middleIndex.exchange(frontIndex, std::memory_order_acq_rel);
+        frontIndex = previous & indexMask;
+        return true;
+    }
+
+    const Type& getReadBuffer() const { return slots[(size_t) frontIndex]; }
+
+private:
+    static constexpr int indexMask = 3;
+    static constexpr int freshFlag = 4;
+
+    std::array<Type, 3> slots {};
+    int backIndex = 0;                 // owned by the writer
+    int frontIndex = 1;                // owned by the reader
+    std::atomic<int> middleIndex { 2 };
+
+    JUCE_DECLARE_NON_COPYABLE(TripleBuffer)
+};
@@ -0,0 +1,234 @@
+#include "TuningCodec.h"
+
+namespace TuningCodec
+{
+namespace
+{
+    constexpr juce::uint8 invalid = 0xff;
+
+    struct Base64Table
+    {
+        std::array<juce::uint8, 256> values;
+
+        Base64Table()
+        {
+            values.fill(invalid);
+            const char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+            for (int i = 0; i < 64; ++i)
+                values[(size_t) (juce::uint8) alphabet[i]] = static_cast<juce::uint8>(i);
+        }
+    };
+
+    // Decodes into a fixed buffer, returns the byte count or -1 on bad input
+    int decodeBase64(const char* text, size_t numChars, juce::uint8* dest, size_t destSize)
+    {
+        static const Base64Table table;
+
+        while (numChars > 0 && text[numChars - 1] == '=')
+            --numChars;
+
+        size_t numBytes = (numChars * 3) / 4;
+
+        if (numChars % 4 == 1 || numBytes > destSize)
+            return -1;
+
+        juce::uint32 accumulator = 0;
+        int bits = 0;
+        size_t written = 0;
+
+        for (size_t i = 0; i < numChars; ++i)
+        {
+            auto value = table.values[(size_t) (juce::uint8) text[i]];
+
+            if (value == invalid)
+                return -1;
+
+            accumulator = (accumulator << 6) | value;
+            bits += 6;
+
+            if (bits >= 8)
+            {
+                bits -= 8;
+                dest[written++] = static_cast<juce::uint8>(accumulator >> bits);
+            }
+        }
+
+        return static_cast<int>(written);
+    }
+
+    float readFloat(const juce::uint8* data)
+    {
+        auto bits = juce::ByteOrder::littleEndianInt(data);
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    double readDouble(const juce::uint8* data)
+    {
+        auto bits = juce::ByteOrder::littleEndianInt64(data);
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    void writeFloat(juce::MemoryOutputStream& stream, float value)
+    {
+        juce::uint32 bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        stream.writeInt(static_cast<int>(bits));
+    }
+
+    void writeDouble(juce::MemoryOutputStream& stream, double value)
+    {
+        juce::uint64 bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        stream.writeInt64(static_cast<juce::int64>(bits));
+    }
+
+    void writeHeader(juce::MemoryOutputStream& stream, FrameType type, juce::uint32 requestId)
+    {
+        stream.writeByte('T');
+        stream.writeByte('B');
+        stream.writeByte(static_cast<char>(version));
+        stream.writeByte(static_cast<char>(type));
+        stream.writeInt(static_cast<int>(requestId));
+    }
+
+    juce::String toFrameString(const juce::MemoryOutputStream& stream)
+    {
+        return juce::String::charToString(framePrefix) + juce::Base64::toBase64(stream.getData(), stream.getDataSize());
+    }
+}
+
+bool decode(const char* text, size_t numChars, Frame& frame)
+{
+    if (numChars == 0 || text[0] != framePrefix)
+        return false;
+
+    std::array<juce::uint8, maxFrameBytes> bytes;
+    auto numBytes = decodeBase64(text + 1, numChars - 1, bytes.data(), bytes.size());
+
+    if (numBytes < (int) headerBytes || bytes[0] != 'T' || bytes[1] != 'B' || bytes[2] != version)
+        return false;
+
+    frame.type = static_cast<FrameType>(bytes[3]);
+    frame.requestId = juce::ByteOrder::littleEndianInt(bytes.data() + 4);
+
+    const auto* payload = bytes.data() + headerBytes;
+    auto payloadSize = static_cast<size_t>(numBytes) - headerBytes;
+
+    switch (frame.type)
+    {
+        case FrameType::fullTable:
+        {
+            if (payloadSize != 128 * sizeof(float))
+                return false;
+
+            frame.numEntries = 128;
+
+            for (int note = 0; note < 128; ++note)
+            {
+                frame.notes[(size_t) note] = static_cast<juce::uint8>(note);
+                frame.cents[(size_t) note] = readFloat(payload + note * sizeof(float));
+
+                // NaN or inf would pass every range check on the way to the bends
+                if (! std::isfinite(frame.cents[(size_t) note]))
+                    return false;
+            }
+
+            return true;
+        }
+
+        case FrameType::delta:
+        {
+            if (payloadSize < 1)
+                return false;
+
+            constexpr size_t entryBytes = 1 + sizeof(float);
+            frame.numEntries = payload[0];
+
+            if (frame.numEntries > 128 || payloadSize != 1 + (size_t) frame.numEntries * entryBytes)
+                return false;
+
+            for (int i = 0; i < frame.numEntries; ++i)
+            {
+                const auto* entry = payload + 1 + (size_t) i * entryBytes;
+
+                if (entry[0] > 127)
+                    return false;
+
+                frame.notes[(size_t) i] = entry[0];
+                frame.cents[(size_t) i] = readFloat(entry + 1);
+
+                if (! std::isfinite(frame.cents[(size_t) i]))
+                    return false;
+            }
+
+            return true;
+        }
+
+        case FrameType::frequencySet:
+        {
+            if (payloadSize < 2)
+                return false;
+
+            frame.numFrequencies = juce::ByteOrder::littleEndianShort(payload);
+
+            if (frame.numFrequencies > maxFrequencies
+                || payloadSize != 2 + (size_t) frame.numFrequencies * sizeof(double))
+                return false;
+
+            for (int i = 0; i < frame.numFrequencies; ++i)
+                frame.frequencies[(size_t) i] = readDouble(payload + 2 + (size_t) i * sizeof(double));
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+juce::String encodeFullTable(juce::uint32 requestId, const std::array<float, 128>& cents)
+{
+    juce::MemoryOutputStream stream(maxFrameBytes);
+    writeHeader(stream, FrameType::fullTable, requestId);
+
+    for (auto value : cents)
+        writeFloat(stream, value);
+
+    return toFrameString(stream);
+}
+
+juce::String encodeDelta(juce::uint32 requestId, const juce::uint8* notes, const float* cents, int numEntries)
+{
+    jassert(juce::isPositiveAndNotGreaterThan(numEntries, 128));
+
+    juce::MemoryOutputStream stream(maxFrameBytes);
+    writeHeader(stream, FrameType::delta, requestId);
+    stream.writeByte(static_cast<char>(numEntries));
+
+    for (int i = 0; i < numEntries; ++i)
+    {
+        stream.writeByte(static_cast<char>(notes[i]));
+        writeFloat(stream, cents[i]);
+    }
+
+    return toFrameString(stream);
+}
+
+juce::String encodeFrequencySet(juce::uint32 requestId, const double* frequencies, int numFrequencies)
+{
+    jassert(juce::isPositiveAndNotGreaterThan(numFrequencies, maxFrequencies));
+
+    juce::MemoryOutputStream stream(maxFrameBytes);
+    writeHeader(stream, FrameType::frequencySet, requestId);
+    stream.writeShort(static_cast<short>(numFrequencies));
+
+    for (int i = 0; i < numFrequencies; ++i)
+        writeDouble(stream, frequencies[i]);
+
+    return toFrameString(stream);
+}
+}
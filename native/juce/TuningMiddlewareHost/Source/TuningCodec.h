@@ -0,0 +1,59 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+
+/**
+ * TuningCodec - Compact binary frames for bulk tuning updates
+ *
+ * Frames share the WebView's string channel as '!' followed by base64, which can
+ * never be mistaken for JSON. Decoding touches no juce::var and no heap memory.
+ *
+ * Frame layout (little endian):
+ *   u8 'T', u8 'B', u8 version, u8 type, u32 request id, then the payload:
+ *   fullTable  128 x f32 cents
+ *   delta      u8 count, count x (u8 note, f32 cents)
+ *   freqSet    u16 count, count x f64 Hz (count 0 clears the set)
+ */
+namespace TuningCodec
+{
+    constexpr char framePrefix = '!';
+    constexpr juce::uint8 version = 1;
+
+    enum class FrameType : juce::uint8
+    {
+        fullTable = 1,
+        delta = 2,
+        frequencySet = 3
+    };
+
+    constexpr int maxFrequencies = 512;   // matches TuningEngine::maxFrequencies
+
+    constexpr size_t headerBytes = 8;
+    // The frequency set is the largest payload
+    constexpr size_t maxFrameBytes = headerBytes + 2 + maxFrequencies * sizeof(double);
+
+    struct Frame
+    {
+        FrameType type = FrameType::fullTable;
+        juce::uint32 requestId = 0;
+
+        // fullTable fills all 128 entries in note order
+        int numEntries = 0;
+        std::array<juce::uint8, 128> notes {};
+        std::array<float, 128> cents {};
+
+        // frequencySet only
+        int numFrequencies = 0;
+        std::array<double, maxFrequencies> frequencies {};
+    };
+
+    // Decodes a frame including its '!' prefix; returns false if it is malformed
+    // or any cents value isn't finite
+    bool decode(const char* text, size_t numChars, Frame& frame);
+
+    // Encoders, used by native tools and benchmarks (the UI has its own in bridge.ts)
+    juce::String encodeFullTable(juce::uint32 requestId, const std::array<float, 128>& cents);
+    juce::String encodeDelta(juce::uint32 requestId, const juce::uint8* notes, const float* cents, int numEntries);
+    juce::String encodeFrequencySet(juce::uint32 requestId, const double* frequencies, int numFrequencies);
+}
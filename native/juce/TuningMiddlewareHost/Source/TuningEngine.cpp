@@ -1,53 +1,629 @@
 #include "TuningEngine.h"
 
+namespace
+{
+    // juce::MidiBuffer stores each event as an int32 sample position and a uint16 size, then the bytes
+    constexpr int eventHeaderSize = sizeof(juce::int32) + sizeof(juce::uint16);
+
+    // A linear morph by amount (0 = source, 1 = target), then a stretch about A4 and
+    // a transposition, as setTuningFromPresets() describes. dest may not be a source.
+    void morphTables(const float* source, const float* target, float* dest, float amount, float stretch, float transposeCents)
+    {
+        // Cents from A4 of every key, the axis a stretch scales about
+        static const auto keyOffsets = []
+        {
+            std::array<float, 128> offsets {};
+
+            for (int note = 0; note < 128; ++note)
+                offsets[(size_t) note] = (float) ((note - 69) * 100);
+
+            return offsets;
+        }();
+
+        amount = juce::jlimit(0.0f, 1.0f, amount);
+        stretch = juce::jlimit(0.25f, 4.0f, stretch);
+        transposeCents = juce::jlimit(-9600.0f, 9600.0f, transposeCents);
+
+        juce::FloatVectorOperations::copyWithMultiply(dest, source, 1.0f - amount, 128);
+        juce::FloatVectorOperations::addWithMultiply(dest, target, amount, 128);
+
+        // (key + cents) * stretch - key, as an offset from the key again
+        if (stretch != 1.0f)
+        {
+            juce::FloatVectorOperations::multiply(dest, stretch, 128);
+            juce::FloatVectorOperations::addWithMultiply(dest, keyOffsets.data(), stretch - 1.0f, 128);
+        }
+
+        if (transposeCents != 0.0f)
+            juce::FloatVectorOperations::add(dest, transposeCents, 128);
+    }
+}
+
 TuningEngine::TuningEngine()
 {
-    // Initialize tuning table to 12TET (0 cents deviation)
-    tuningTable.fill(0.0f);
-    
-    // Initialize active notes
-    for (auto& channel : activeNotes)
-        for (auto& note : channel)
-            note = ActiveNote{};
+    // Initialize every preset to 12TET (0 cents deviation)
+    for (auto& preset : editState.presets)
+        preset.tuningTable.fill(0.0f);
+
+    publishState();
+    stateExchange.acquire();
+    channelBends.fill(-1);
+}
+
+void TuningEngine::prepare(double sampleRate, int samplesPerBlock)
+{
+    currentSampleRate = sampleRate > 0.0 ? sampleRate : 44100.0;
+
+    // Glides step at most once per millisecond to keep the MIDI stream light
+    glideStepSamples = juce::jmax(1, juce::roundToInt(currentSampleRate / 1000.0));
+
+    // Each event is stored as a 4-byte timestamp, a 2-byte size and up to 3 bytes
+    // of data. Note-ons expand into a pitch wheel + note-on pair, hence the 2x.
+    constexpr size_t bytesPerEvent = sizeof(juce::int32) + sizeof(juce::uint16) + 3;
+    auto numEvents = static_cast<size_t>(juce::jmax(maxEventsPerBlock, samplesPerBlock));
+
+    reservedOutputBytes = numEvents * 2 * bytesPerEvent;
+    outputBlock.ensureSize(reservedOutputBytes);
+
+    // The destination may have been reset or swapped while we were stopped
+    channelBends.fill(-1);
+}
+
+void TuningEngine::setMaxEventsPerBlock(int numEvents)
+{
+    maxEventsPerBlock = juce::jmax(1, numEvents);
 }
 
 void TuningEngine::setTuningTable(const std::array<float, 128>& cents)
 {
-    tuningTable = cents;
+    setPresetTable(getCurrentPreset(), cents);
+}
+
+void TuningEngine::setTuningEntries(const juce::uint8* notes, const float* cents, int numEntries)
+{
+    const juce::SpinLock::ScopedLockType lock(writerLock);
+
+    // Read once: MIDI can switch presets meanwhile, and the edit and rebuild must agree
+    auto index = getCurrentPreset();
+    auto& table = editState.presets[(size_t) index].tuningTable;
+
+    for (int i = 0; i < numEntries; ++i)
+        if (notes[i] < 128)
+            table[notes[i]] = cents[i];
+
+    publishState(index);
+}
+
+void TuningEngine::setPresetTable(int index, const std::array<float, 128>& cents)
+{
+    if (! juce::isPositiveAndBelow(index, maxPresets))
+        return;
+
+    const juce::SpinLock::ScopedLockType lock(writerLock);
+    editState.presets[(size_t) index].tuningTable = cents;
+    publishState(index);
+}
+
+bool TuningEngine::setTuningFromPresets(int from, int to, float amount, float stretch, float transposeCents)
+{
+    const juce::SpinLock::ScopedLockType lock(writerLock);
+    auto index = getCurrentPreset();
+
+    if (! juce::isPositiveAndBelow(from, maxPresets) || ! juce::isPositiveAndBelow(to, maxPresets))
+        return false;
+
+    // Into a copy first, as a source may be the destination and is read across it
+    std::array<float, 128> cents;
+    morphTables(editState.presets[(size_t) from].tuningTable.data(), editState.presets[(size_t) to].tuningTable.data(),
+                cents.data(), amount, stretch, transposeCents);
+    editState.presets[(size_t) index].tuningTable = cents;
+
+    publishState(index);
+    return true;
+}
+
+bool TuningEngine::getTuningFromPresets(int from, int to, float amount, float stretch, float transposeCents,
+                                        std::array<float, 128>& cents) const
+{
+    if (! juce::isPositiveAndBelow(from, maxPresets) || ! juce::isPositiveAndBelow(to, maxPresets))
+        return false;
+
+    const juce::SpinLock::ScopedLockType lock(writerLock);
+    morphTables(editState.presets[(size_t) from].tuningTable.data(), editState.presets[(size_t) to].tuningTable.data(),
+                cents.data(), amount, stretch, transposeCents);
+    return true;
+}
+
+std::array<float, 128> TuningEngine::getTuningTable() const
+{
+    const juce::SpinLock::ScopedLockType lock(writerLock);
+    std::array<float, 128> cents;
+
+    if (editState.sharedTable != nullptr)
+        editState.sharedTable->read(cents);
+    else
+        cents = editState.presets[(size_t) getCurrentPreset()].tuningTable;
+
+    return cents;
+}
+
+std::array<float, 128> TuningEngine::getPresetTable(int index) const
+{
+    const juce::SpinLock::ScopedLockType lock(writerLock);
+    return editState.presets[(size_t) juce::jlimit(0, maxPresets - 1, index)].tuningTable;
+}
+
+void TuningEngine::selectPreset(int index)
+{
+    if (juce::isPositiveAndBelow(index, maxPresets))
+        requestedPreset.store(index, std::memory_order_release);
+}
+
+void TuningEngine::setSharedTable(SharedTable::Ptr table)
+{
+    const juce::SpinLock::ScopedLockType lock(writerLock);
+
+    if (table == editState.sharedTable)
+        return;
+
+    // Leaving, only the preset that takes the shared table needs its bends rebuilt
+    auto changedPreset = -1;
+
+    if (table == nullptr)
+    {
+        changedPreset = getCurrentPreset();
+        editState.sharedTable->read(editState.presets[(size_t) changedPreset].tuningTable);
+    }
+
+    editState.sharedTable = std::move(table);
+    publishState(changedPreset);
+}
+
+juce::uint32 TuningEngine::getSharedTableSerial() const
+{
+    const juce::SpinLock::ScopedLockType lock(writerLock);
+    return editState.sharedTable != nullptr ? editState.sharedTable->getSerial() : 0;
+}
+
+int TuningEngine::getCurrentPreset() const
+{
+    // A selection the audio thread hasn't picked up yet already counts
+    auto requested = requestedPreset.load(std::memory_order_acquire);
+    return requested >= 0 ? requested : playingPreset.load(std::memory_order_acquire);
+}
+
+void TuningEngine::setFrequencySet(const double* frequenciesHz, int numFrequencies)
+{
+    const juce::SpinLock::ScopedLockType lock(writerLock);
+    storeFrequencySet(editState, frequenciesHz, numFrequencies);
+    publishState();
+}
+
+void TuningEngine::storeFrequencySet(TuningState& state, const double* frequenciesHz, int numFrequencies)
+{
+    int numPitches = 0;
+
+    for (int i = 0; i < numFrequencies && numPitches < maxFrequencies; ++i)
+        if (frequenciesHz[i] > 0.0 && std::isfinite(frequenciesHz[i]))
+            state.pitchSet[(size_t) numPitches++] = 69.0 + 12.0 * std::log2(frequenciesHz[i] / 440.0);
+
+    std::sort(state.pitchSet.begin(), state.pitchSet.begin() + numPitches);
+    state.numPitches = numPitches;
+}
+
+void TuningEngine::getFrequencySet(juce::Array<double>& frequenciesHz) const
+{
+    // Copied out first, so the array isn't grown with the lock held
+    std::array<double, maxFrequencies> pitches;
+    int numPitches;
+
+    {
+        const juce::SpinLock::ScopedLockType lock(writerLock);
+        numPitches = editState.numPitches;
+        std::copy(editState.pitchSet.begin(), editState.pitchSet.begin() + numPitches, pitches.begin());
+    }
+
+    frequenciesHz.clearQuick();
+
+    for (int i = 0; i < numPitches; ++i)
+        frequenciesHz.add(440.0 * std::exp2((pitches[(size_t) i] - 69.0) / 12.0));
+}
+
+void TuningEngine::setRetuningStrategy(RetuningStrategy::Ptr strategy)
+{
+    const juce::SpinLock::ScopedLockType lock(writerLock);
+    editState.retuningStrategy = std::move(strategy);
+    publishState();
+}
+
+void TuningEngine::setPresetSwitching(bool useProgramChange, int controllerNumber)
+{
+    const juce::SpinLock::ScopedLockType lock(writerLock);
+    editState.presetProgramChange = useProgramChange;
+    editState.presetController = juce::isPositiveAndBelow(controllerNumber, 128) ? controllerNumber : -1;
+    publishState();
 }
 
 void TuningEngine::setPitchBendRange(float semitones)
 {
-    pitchBendRange = juce::jlimit(1.0f, 96.0f, semitones);
+    const juce::SpinLock::ScopedLockType lock(writerLock);
+    editState.pitchBendRange = juce::jlimit(1.0f, 96.0f, semitones);
+    publishState();
 }
 
-int TuningEngine::calculatePitchBend(float cents) const
+void TuningEngine::setInputPitchBendRange(float semitones)
 {
-    if (pitchBendRange <= 0.0f)
+    const juce::SpinLock::ScopedLockType lock(writerLock);
+    editState.inputPitchBendRange = juce::jlimit(0.0f, 96.0f, semitones);
+    publishState();
+}
+
+void TuningEngine::setTuning(const std::array<float, 128>& cents, float pitchBendSemitones)
+{
+    const juce::SpinLock::ScopedLockType lock(writerLock);
+    auto index = getCurrentPreset();
+    auto range = juce::jlimit(1.0f, 96.0f, pitchBendSemitones);
+
+    editState.presets[(size_t) index].tuningTable = cents;
+
+    // Every preset's bends depend on the range, so only a new range rebuilds them all
+    if (range == editState.pitchBendRange)
+    {
+        publishState(index);
+        return;
+    }
+
+    editState.pitchBendRange = range;
+    publishState();
+}
+
+void TuningEngine::setNoteMapping(NoteMapping mapping)
+{
+    const juce::SpinLock::ScopedLockType lock(writerLock);
+    editState.noteMapping = mapping;
+    publishState();
+}
+
+void TuningEngine::setHeldNoteRetune(HeldNoteRetune mode, float glideMilliseconds)
+{
+    const juce::SpinLock::ScopedLockType lock(writerLock);
+    editState.heldNoteRetune = mode;
+    editState.retuneGlideMs = juce::jlimit(0.0f, 2000.0f, glideMilliseconds);
+    publishState();
+}
+
+void TuningEngine::setOutputProtocol(OutputProtocol protocol)
+{
+    const juce::SpinLock::ScopedLockType lock(writerLock);
+    editState.outputProtocol = protocol;
+    publishState();
+}
+
+void TuningEngine::setVoiceAllocation(const VoiceAllocator::Config& config)
+{
+    const juce::SpinLock::ScopedLockType lock(writerLock);
+    editState.voiceAllocation = config;
+    publishState();
+}
+
+void TuningEngine::restoreState(const SavedState& saved)
+{
+    const juce::SpinLock::ScopedLockType lock(writerLock);
+
+    for (size_t index = 0; index < editState.presets.size(); ++index)
+        editState.presets[index].tuningTable = saved.presets[index];
+
+    editState.presetProgramChange = saved.presetProgramChange;
+    editState.presetController = juce::isPositiveAndBelow(saved.presetController, 128) ? saved.presetController : -1;
+    storeFrequencySet(editState, saved.frequenciesHz.data(), saved.numFrequencies);
+    editState.retuningStrategy = saved.retuningStrategy;
+
+    editState.pitchBendRange = juce::jlimit(1.0f, 96.0f, saved.pitchBendRange);
+    editState.inputPitchBendRange = juce::jlimit(0.0f, 96.0f, saved.inputPitchBendRange);
+    editState.noteMapping = saved.noteMapping;
+    editState.heldNoteRetune = saved.heldNoteRetune;
+    editState.retuneGlideMs = juce::jlimit(0.0f, 2000.0f, saved.retuneGlideMs);
+    editState.outputProtocol = saved.outputProtocol;
+    editState.voiceAllocation = saved.voiceAllocation;
+
+    // Selected before publishing, so listeners already see the restored preset
+    selectPreset(saved.selectedPreset);
+    publishState();
+}
+
+void TuningEngine::copyState(SavedState& dest) const
+{
+    const juce::SpinLock::ScopedLockType lock(writerLock);
+    copyEditState(dest);
+}
+
+void TuningEngine::copyEditState(SavedState& dest) const
+{
+    for (size_t index = 0; index < editState.presets.size(); ++index)
+        dest.presets[index] = editState.presets[index].tuningTable;
+
+    dest.selectedPreset = getCurrentPreset();
+
+    // What the selected preset plays, so saves and listeners see the shared table
+    if (editState.sharedTable != nullptr)
+        editState.sharedTable->read(dest.presets[(size_t) dest.selectedPreset]);
+    dest.presetProgramChange = editState.presetProgramChange;
+    dest.presetController = editState.presetController;
+
+    dest.numFrequencies = editState.numPitches;
+
+    for (int i = 0; i < editState.numPitches; ++i)
+        dest.frequenciesHz[(size_t) i] = 440.0 * std::exp2((editState.pitchSet[(size_t) i] - 69.0) / 12.0);
+
+    dest.retuningStrategy = editState.retuningStrategy;
+
+    dest.pitchBendRange = editState.pitchBendRange;
+    dest.inputPitchBendRange = editState.inputPitchBendRange;
+    dest.noteMapping = editState.noteMapping;
+    dest.heldNoteRetune = editState.heldNoteRetune;
+    dest.retuneGlideMs = editState.retuneGlideMs;
+    dest.outputProtocol = editState.outputProtocol;
+    dest.voiceAllocation = editState.voiceAllocation;
+    dest.serial = editState.serial;
+}
+
+void TuningEngine::addStateListener(StateListener* listener, bool notifyNow)
+{
+    const juce::SpinLock::ScopedLockType lock(writerLock);
+    stateListeners.addIfNotAlreadyThere(listener);
+
+    if (notifyNow)
+    {
+        copyEditState(listenerState);
+        listener->tuningStatePublished(listenerState);
+    }
+}
+
+void TuningEngine::removeStateListener(StateListener* listener)
+{
+    const juce::SpinLock::ScopedLockType lock(writerLock);
+    stateListeners.removeFirstMatchingValue(listener);
+}
+
+void TuningEngine::getKeyFrequencies(const SavedState& state, std::array<double, 128>& frequenciesHz)
+{
+    const auto& table = state.presets[(size_t) juce::jlimit(0, maxPresets - 1, state.selectedPreset)];
+    auto first = state.frequenciesHz.begin();
+    auto last = first + state.numFrequencies;
+
+    for (int note = 0; note < 128; ++note)
+    {
+        auto frequency = 440.0 * std::exp2((note + table[(size_t) note] / 100.0 - 69.0) / 12.0);
+
+        if (state.numFrequencies > 0)
+        {
+            // Nearest in pitch, as findNearestPitch() picks: the smaller ratio wins
+            auto above = std::lower_bound(first, last, frequency);
+
+            if (above == last)
+                frequency = *(last - 1);
+            else if (above == first || frequency * frequency > *(above - 1) * *above)
+                frequency = *above;
+            else
+                frequency = *(above - 1);
+        }
+
+        frequenciesHz[(size_t) note] = frequency;
+    }
+}
+
+void TuningEngine::publishState(int changedPreset)
+{
+    ++editState.serial;
+
+    if (juce::isPositiveAndBelow(changedPreset, maxPresets))
+        rebuildNoteMap(editState.presets[(size_t) changedPreset], editState);
+    else
+        rebuildNoteMap(editState);
+
+    stateExchange.getWriteBuffer() = editState;
+    stateExchange.publish();
+
+    if (stateListeners.isEmpty())
+        return;
+
+    copyEditState(listenerState);
+
+    for (auto* listener : stateListeners)
+        listener->tuningStatePublished(listenerState);
+}
+
+int TuningEngine::calculatePitchBend(double cents, float pitchBendRange)
+{
+    // Negated so a NaN range falls through to centre too; roundToInt of NaN is undefined
+    if (!(pitchBendRange > 0.0f) || !std::isfinite(cents))
         return 8192;
 
     // Range is +/- pitchBendRange semitones = +/- (pitchBendRange * 100) cents
-    float rangeCents = pitchBendRange * 100.0f;
-    float normalized = cents / rangeCents; // -1 to 1
+    double rangeCents = pitchBendRange * 100.0;
+    double normalized = cents / rangeCents; // -1 to 1
 
-    // Map to 0-16383 where 8192 is center
-    int value = static_cast<int>(8192.0f + normalized * 8192.0f);
+    // Map to 0-16383 where 8192 is center, rounding to the nearest step
+    int value = juce::roundToInt(8192.0 + normalized * 8192.0);
     return juce::jlimit(0, 16383, value);
 }
 
-void TuningEngine::processBlock(juce::MidiBuffer& midiMessages)
+juce::uint32 TuningEngine::calculatePerNoteBend(double cents, float pitchBendRange)
 {
-    juce::MidiBuffer processedMidi;
+    if (!(pitchBendRange > 0.0f) || !std::isfinite(cents))
+        return Ump::centreValue;
 
-    for (const auto metadata : midiMessages)
+    // Same mapping as above with 2^31 steps each way instead of 8192
+    auto normalized = cents / (pitchBendRange * 100.0);
+    auto value = std::llround(2147483648.0 + normalized * 2147483648.0);
+    return static_cast<juce::uint32>(juce::jlimit<long long>(0, 0xffffffffLL, value));
+}
+
+double TuningEngine::findNearestPitch(const TuningState& state, double pitch)
+{
+    auto first = state.pitchSet.begin();
+    auto last = first + state.numPitches;
+    auto above = std::lower_bound(first, last, pitch);
+
+    if (above == first)
+        return *first;
+
+    if (above == last)
+        return *(last - 1);
+
+    auto below = above - 1;
+    return (pitch - *below) <= (*above - pitch) ? *below : *above;
+}
+
+double TuningEngine::resolveNote(const TuningState& state, const NoteMap& map, int note, int& outputNote, int& pitchBend)
+{
+    auto pitch = note + map.tuningTable[(size_t) note] / 100.0;
+
+    if (state.numPitches == 0)
+    {
+        // Bend and output note were precomputed when the table was published
+        outputNote = map.outputNotes[(size_t) note];
+        pitchBend = map.pitchBends[(size_t) note];
+        return pitch;
+    }
+
+    pitch = findNearestPitch(state, pitch);
+
+    outputNote = state.noteMapping == NoteMapping::nearestKey
+                     ? juce::jlimit(0, 127, juce::roundToInt(pitch))
+                     : note;
+
+    pitchBend = calculatePitchBend((pitch - outputNote) * 100.0, state.pitchBendRange);
+    return pitch;
+}
+
+void TuningEngine::rebuildNoteMap(TuningState& state)
+{
+    for (auto& preset : state.presets)
+        rebuildNoteMap(preset, state);
+}
+
+void TuningEngine::rebuildNoteMap(NoteMap& preset, const TuningState& state)
+{
+    for (int note = 0; note < 128; ++note)
+    {
+        auto cents = preset.tuningTable[(size_t) note];
+        auto outputNote = note;
+
+        if (state.noteMapping == NoteMapping::nearestKey)
+        {
+            // Move the whole-semitone part of the offset into the key itself
+            auto targetPitch = note * 100.0 + cents;
+            outputNote = juce::jlimit(0, 127, juce::roundToInt(targetPitch / 100.0));
+            cents = static_cast<float>(targetPitch - outputNote * 100.0);
+        }
+
+        preset.pitchBends[(size_t) note] = static_cast<juce::uint16>(calculatePitchBend(cents, state.pitchBendRange));
+        preset.outputNotes[(size_t) note] = static_cast<juce::uint8>(outputNote);
+    }
+}
+
+void TuningEngine::processBlock(juce::MidiBuffer& midiMessages, int numSamples)
+{
+    processBlock(midiMessages, numSamples, nullptr);
+}
+
+void TuningEngine::processBlock(juce::MidiBuffer& midiMessages, int numSamples, UmpBuffer* umpDestination)
+{
+    // A block the engine edits is written out in time order to outputBlock, which
+    // prepare() reserved, and copied back once at the end; the host's buffer is
+    // only read until then. Only growth beyond the reserve counts as a reallocation.
+    block = &midiMessages;
+    blockCursor = 0;
+    outputBlock.clear();
+    lastOutputPosition = std::numeric_limits<int>::min();
+    blockEventsIn = blockEventsOut = 0;
+    auto allocatedBytes = outputBlock.data.getNumAllocated();
+
+    // Updates are adopted here and nowhere else, so a block never sees two tables
+
+    auto stateChanged = stateExchange.acquire();
+    const auto& state = stateExchange.getReadBuffer();
+
+    // A shared table is read here too, so its edits reach held voices like any
+    // other. Its bends depend on the state's settings as well as the table.
+    if (state.sharedTable != nullptr
+        && (state.sharedTable->readIfChanged(sharedTableSerial, sharedMap.tuningTable) || stateChanged))
+    {
+        rebuildNoteMap(sharedMap, state);
+        stateChanged = true;
+    }
+
+    // A destination that can't take packets gets MIDI 1.0, whatever the setting
+    auto protocol = umpDestination != nullptr ? state.outputProtocol : OutputProtocol::midi1;
+    umpOutput = protocol != OutputProtocol::midi1 ? umpDestination : nullptr;
+
+    if (umpDestination != nullptr)
+        umpDestination->clear();
+
+    auto reservedPackets = umpOutput != nullptr ? umpOutput->getNumAllocated() : 0;
+
+    // Ranges are fixed for the block, so composing a bend needs no division by them
+    inputCentsPerStep = state.inputPitchBendRange * 100.0 / 8192.0;
+    outputCentsPerStep = state.pitchBendRange * 100.0 / 8192.0;
+
+    auto requested = requestedPreset.exchange(-1, std::memory_order_acq_rel);
+    if (juce::isPositiveAndBelow(requested, maxPresets) && requested != currentPreset)
+    {
+        currentPreset = requested;
+        playingPreset.store(requested, std::memory_order_release);
+        stateChanged = true;
+    }
+
+    blockStartPreset = currentPreset;
+
+    if (stateChanged || protocol != renderedProtocol)
     {
-        auto message = metadata.getMessage();
-        int samplePosition = metadata.samplePosition;
+        // MIDI 2.0 tells notes apart by channel and key alone, so it never rotates
+        auto allocation = protocol == OutputProtocol::midi1 ? state.voiceAllocation : VoiceAllocator::Config {};
+
+        if (protocol != renderedProtocol || allocation != voiceAllocator.getConfig())
+        {
+            releaseAllVoices(0);
+            voiceAllocator.setConfig(allocation);
+
+            // Switching protocol may mean a different destination
+            if (protocol != renderedProtocol)
+                channelBends.fill(-1);
+
+            renderedProtocol = protocol;
+        }
+        else if (state.heldNoteRetune != HeldNoteRetune::off)
+        {
+            retuneHeldVoices(state, 0);
+        }
+    }
+
+    // Blocks with nothing for the engine to do (no notes, wheel, preset switch or glide)
+    // are left exactly as they came, and MIDI 2.0 needs every event translated
+    // (events already written, such as the bends of a retune, count as an edit)
+    auto needsEditing = umpOutput != nullptr || glidesActive || ! outputBlock.isEmpty()
+                     || blockNeedsEditing(midiMessages, state);
+
+    while (needsEditing && blockCursor < midiMessages.data.size())
+    {
+        ++blockEventsIn;
+        int samplePosition = juce::readUnaligned<juce::int32>(midiMessages.data.begin() + blockCursor);
+
+        // Glide steps due before this event go out first, in time order
+        if (glidesActive)
+            advanceGlides(samplePosition);
+
+        auto* event = midiMessages.data.begin() + blockCursor;
+        auto numBytes = static_cast<int>(juce::readUnaligned<juce::uint16>(event + sizeof(juce::int32)));
+        auto eventSize = eventHeaderSize + numBytes;
+
+        juce::MidiMessage message(event + eventHeaderSize, numBytes, samplePosition);
         int channel = message.getChannel() - 1; // 0-indexed
 
         if (channel < 0 || channel >= 16)
         {
-            processedMidi.addEvent(message, samplePosition);
+            keepEvent(message, eventSize, samplePosition);
             continue;
         }
 
@@ -56,59 +632,560 @@ void TuningEngine::processBlock(juce::MidiBuffer& midiMessages)
             int note = message.getNoteNumber();
             int velocity = message.getVelocity();
 
-            // Get cents deviation for this note
-            float cents = tuningTable[note];
+            int outputNote, pitchBend;
+            auto pitch = resolveNote(state, getPlayingMap(state), note, outputNote, pitchBend);
 
-            // Calculate pitch bend
-            int pitchBend = calculatePitchBend(cents);
+            // Claim a voice; a stolen or retriggered one is silenced first
+            VoiceAllocator::Voice displaced;
+            auto& voice = voiceAllocator.noteOn(channel, note, displaced);
 
-            // Store active note info
-            activeNotes[channel][note] = { note, note, pitchBend };
+            if (displaced.isActive())
+            {
+                send(juce::MidiMessage::noteOff(displaced.outputChannel + 1, displaced.outputNote), samplePosition);
+                reportVoice(VoiceTelemetry::Event::Type::noteOff, displaced, samplePosition);
+                heldNotes.remove(displaced.inputChannel, displaced.inputNote);
+
+                if (displaced.inputChannel != channel || displaced.inputNote != note)
+                    numVoiceSteals.add();
+            }
+
+            if (state.retuningStrategy != nullptr)
+            {
+                // The strategy sees the chord as it sounds, without this note
+                pitch = state.retuningStrategy->choosePitch(note, pitch, heldNotes);
+
+                outputNote = state.noteMapping == NoteMapping::nearestKey
+                                 ? juce::jlimit(0, 127, juce::roundToInt(pitch))
+                                 : note;
+                pitchBend = calculatePitchBend((pitch - outputNote) * 100.0, state.pitchBendRange);
+            }
 
-            // Send pitch bend first
-            auto pbMessage = juce::MidiMessage::pitchWheel(channel + 1, pitchBend);
-            processedMidi.addEvent(pbMessage, samplePosition);
+            heldNotes.add(channel, note, pitch);
+
+            voice.outputNote = static_cast<juce::uint8>(outputNote);
+            voice.pitchBend = static_cast<juce::uint16>(pitchBend);
+
+            if (umpOutput != nullptr)
+            {
+                sendUmpNoteOn(state, voice, pitch, velocity, samplePosition);
+                dropEvent(eventSize);
+            }
+            else
+            {
+                // Send pitch bend first, on the voice's own channel, unless it is already there
+                auto bend = composeBend(pitchBend, channel);
 
-            // Then send note on
-            auto noteOnMessage = juce::MidiMessage::noteOn(channel + 1, note, (juce::uint8)velocity);
-            processedMidi.addEvent(noteOnMessage, samplePosition);
+                if (channelBends[(size_t) voice.outputChannel] != bend)
+                    sendPitchWheel(voice.outputChannel, bend, samplePosition);
+
+                // Then send note on
+                auto noteOnMessage = juce::MidiMessage::noteOn(voice.outputChannel + 1, outputNote, (juce::uint8)velocity);
+                replaceEvent(noteOnMessage, eventSize);
+            }
+
+            reportVoice(VoiceTelemetry::Event::Type::noteOn, voice, samplePosition);
         }
         else if (message.isNoteOff())
         {
             int note = message.getNoteNumber();
             int velocity = message.getVelocity();
 
-            // Get stored note info
-            auto& activeNote = activeNotes[channel][note];
-
-            if (activeNote.originalNote >= 0)
+            if (auto* voice = voiceAllocator.find(channel, note))
             {
-                // Send note off
-                auto noteOffMessage = juce::MidiMessage::noteOff(channel + 1, activeNote.outputNote, (juce::uint8)velocity);
-                processedMidi.addEvent(noteOffMessage, samplePosition);
+                // Send note off where the note was actually played
+                auto noteOffMessage = juce::MidiMessage::noteOff(voice->outputChannel + 1, voice->outputNote, (juce::uint8)velocity);
+                replaceEvent(noteOffMessage, eventSize);
 
-                // Clear active note
-                activeNote = ActiveNote{};
+                reportVoice(VoiceTelemetry::Event::Type::noteOff, *voice, samplePosition);
+                voiceAllocator.release(*voice);
+                heldNotes.remove(channel, note);
             }
             else
             {
                 // Pass through if we don't have record of this note
-                processedMidi.addEvent(message, samplePosition);
+                keepEvent(message, eventSize, samplePosition);
             }
         }
+        else if (message.isAftertouch())
+        {
+            // Polyphonic aftertouch follows its note onto the voice's channel
+            if (auto* voice = voiceAllocator.find(channel, message.getNoteNumber()))
+                replaceEvent(juce::MidiMessage::aftertouchChange(voice->outputChannel + 1, voice->outputNote, message.getAfterTouchValue()), eventSize);
+            else
+                keepEvent(message, eventSize, samplePosition);
+        }
+        else if (message.isProgramChange() && state.presetProgramChange
+                 && juce::isPositiveAndBelow(message.getProgramChangeNumber(), maxPresets))
+        {
+            switchPreset(state, message.getProgramChangeNumber(), samplePosition);
+            dropEvent(eventSize);
+        }
+        else if (message.isController() && message.getControllerNumber() == state.presetController
+                 && juce::isPositiveAndBelow(message.getControllerValue(), maxPresets))
+        {
+            switchPreset(state, message.getControllerValue(), samplePosition);
+            dropEvent(eventSize);
+        }
+        else if (message.isPitchWheel())
+        {
+            // One multiply-add per incoming bend; the voices carry it from here on
+            performerCents[(size_t) channel] = (message.getPitchWheelValue() - 8192) * inputCentsPerStep;
+            applyPerformerBend(channel, samplePosition);
+            dropEvent(eventSize);
+        }
         else
         {
             // Pass through all other messages
-            processedMidi.addEvent(message, samplePosition);
+            keepEvent(message, eventSize, samplePosition);
+        }
+    }
+
+    if (glidesActive)
+        advanceGlides(numSamples);
+
+    sampleClock += numSamples;
+
+    if (outputBlock.data.getNumAllocated() != allocatedBytes
+        || (umpOutput != nullptr && umpOutput->getNumAllocated() != reservedPackets))
+        numOutputReallocations.fetch_add(1, std::memory_order_relaxed);
+
+    // blockNeedsEditing() counted a block that passes, which goes out as it came
+    if (! needsEditing)
+        blockEventsOut = blockEventsIn;
+
+    // Everything went out as packets
+    if (umpOutput != nullptr)
+    {
+        blockEventsOut = umpOutput->getNumEvents();
+        midiMessages.clear();
+    }
+    else if (needsEditing)
+    {
+        // One copy; clear() keeps the host's storage, so only a host buffer smaller
+        // than the output grows, and that is the host's to size
+        midiMessages.clear();
+        midiMessages.data.addArray(outputBlock.data.begin(), outputBlock.data.size());
+    }
+
+    umpOutput = nullptr;
+    block = nullptr;
+}
+
+bool TuningEngine::blockNeedsEditing(const juce::MidiBuffer& midiMessages, const TuningState& state)
+{
+    // Raw status bytes only; nothing is decoded into a MidiMessage here. A block
+    // that needs editing is counted again as it is edited.
+    int numEvents = 0;
+
+    for (const auto metadata : midiMessages)
+    {
+        ++numEvents;
+        auto* bytes = metadata.data;
+        auto status = static_cast<int>(bytes[0]);
+
+        if (metadata.numBytes < 2 || status < 0x80 || status >= 0xf0)
+            continue;
+
+        auto channel = status & 0x0f;
+
+        switch (status & 0xf0)
+        {
+            case 0x80:
+            case 0x90:
+                return true;
+
+            case 0xa0:
+                if (voiceAllocator.find(channel, bytes[1] & 0x7f) != nullptr)
+                    return true;
+                break;
+
+            case 0xb0:
+                if (metadata.numBytes > 2 && bytes[1] == state.presetController && bytes[2] < maxPresets)
+                    return true;
+                break;
+
+            case 0xc0:
+                if (state.presetProgramChange && bytes[1] < maxPresets)
+                    return true;
+                break;
+
+            case 0xe0:
+                return true;
+
+            default:
+                break;
+        }
+    }
+
+    blockEventsIn = numEvents;
+    return false;
+}
+
+
+void TuningEngine::releaseAllVoices(int samplePosition)
+{
+    voiceAllocator.forEachActiveVoice([&](const VoiceAllocator::Voice& voice)
+    {
+        send(juce::MidiMessage::noteOff(voice.outputChannel + 1, voice.outputNote), samplePosition);
+        reportVoice(VoiceTelemetry::Event::Type::noteOff, voice, samplePosition);
+    });
+
+    voiceAllocator.reset();
+    heldNotes.clear();
+}
+
+int TuningEngine::getHeldVoiceBend(const VoiceAllocator::Voice& voice, const TuningState& state, const NoteMap& map)
+{
+    int outputNote, pitchBend;
+    resolveNote(state, map, voice.inputNote, outputNote, pitchBend);
+
+    if (outputNote == voice.outputNote)
+        return pitchBend;
+
+    // The sounding key can't change mid-note, so bend all the way from it
+    auto pitch = state.numPitches > 0
+                     ? findNearestPitch(state, voice.inputNote + map.tuningTable[(size_t) voice.inputNote] / 100.0)
+                     : voice.inputNote + map.tuningTable[(size_t) voice.inputNote] / 100.0;
+
+    return calculatePitchBend((pitch - voice.outputNote) * 100.0, state.pitchBendRange);
+}
+
+void TuningEngine::switchPreset(const TuningState& state, int index, int samplePosition)
+{
+    if (index == currentPreset)
+        return;
+
+    currentPreset = index;
+    playingPreset.store(index, std::memory_order_release);
+
+    if (state.heldNoteRetune != HeldNoteRetune::off)
+        retuneHeldVoices(state, samplePosition);
+}
+
+void TuningEngine::retuneHeldVoices(const TuningState& state, int samplePosition)
+{
+    // Dynamically tuned voices were tuned against each other, not the table
+    if (state.retuningStrategy != nullptr)
+        return;
+
+    if (umpOutput != nullptr)
+    {
+        retuneUmpVoices(state, samplePosition);
+        return;
+    }
+
+    // A pitch wheel is per channel, so only the newest voice on each channel counts
+    std::array<VoiceAllocator::Voice*, 16> channelOwners {};
+
+    voiceAllocator.forEachActiveVoice([&](VoiceAllocator::Voice& voice)
+    {
+        channelOwners[(size_t) voice.outputChannel] = &voice;
+    });
+
+    auto glideLength = juce::roundToInt(state.retuneGlideMs * currentSampleRate / 1000.0);
+    auto useGlide = state.heldNoteRetune == HeldNoteRetune::glide && glideLength > glideStepSamples;
+
+    for (auto* voice : channelOwners)
+    {
+        if (voice == nullptr)
+            continue;
+
+        auto target = getHeldVoiceBend(*voice, state, getPlayingMap(state));
+
+        if (useGlide)
+        {
+            if (target == (voice->isGliding() ? voice->glideTarget : voice->pitchBend))
+                continue;
+
+            voice->glideFrom = voice->pitchBend;
+            voice->glideTarget = static_cast<juce::uint16>(target);
+            voice->glideLength = glideLength;
+            voice->glideStart = static_cast<juce::uint32>(sampleClock + samplePosition);
+            voice->nextGlideStep = voice->glideStart;
+            glidesActive = true;
+        }
+        else if (target != voice->pitchBend)
+        {
+            voice->pitchBend = static_cast<juce::uint16>(target);
+            voice->glideLength = 0;
+            sendPitchWheel(voice->outputChannel, composeBend(target, voice->inputChannel), samplePosition);
+            reportVoice(VoiceTelemetry::Event::Type::pitchBend, *voice, samplePosition);
+        }
+    }
+}
+
+void TuningEngine::retuneUmpVoices(const TuningState& state, int samplePosition)
+{
+    auto glideLength = juce::roundToInt(state.retuneGlideMs * currentSampleRate / 1000.0);
+    auto useGlide = state.heldNoteRetune == HeldNoteRetune::glide && glideLength > glideStepSamples;
+    const auto& map = getPlayingMap(state);
+
+    voiceAllocator.forEachActiveVoice([&](VoiceAllocator::Voice& voice)
+    {
+        int outputNote, pitchBend;
+        auto pitch = resolveNote(state, map, voice.inputNote, outputNote, pitchBend);
+
+        auto& umpNote = getUmpNote(voice);
+        auto target = calculatePerNoteBend((pitch - Ump::fromPitch7_9(umpNote.basePitch)) * 100.0, state.pitchBendRange);
+
+        // The 14-bit fields keep telemetry meaningful; the packets carry the full value
+        auto equivalentBend = calculatePitchBend((pitch - voice.outputNote) * 100.0, state.pitchBendRange);
+
+        if (useGlide)
+        {
+            if (target == (voice.isGliding() ? umpNote.glideTarget : umpNote.pitchBend))
+                return;
+
+            umpNote.glideFrom = umpNote.pitchBend;
+            umpNote.glideTarget = target;
+            voice.glideFrom = voice.pitchBend;
+            voice.glideTarget = static_cast<juce::uint16>(equivalentBend);
+            voice.glideLength = glideLength;
+            voice.glideStart = static_cast<juce::uint32>(sampleClock + samplePosition);
+            voice.nextGlideStep = voice.glideStart;
+            glidesActive = true;
+        }
+        else if (target != umpNote.pitchBend)
+        {
+            umpNote.pitchBend = target;
+            voice.pitchBend = static_cast<juce::uint16>(equivalentBend);
+            voice.glideLength = 0;
+            sendPerNoteBend(voice, target, samplePosition);
+            reportVoice(VoiceTelemetry::Event::Type::pitchBend, voice, samplePosition);
+        }
+    });
+}
+
+void TuningEngine::advanceGlides(int blockPosition)
+{
+    // Wrapping 32-bit sample times, compared by their signed difference
+    auto blockStart = static_cast<juce::uint32>(sampleClock);
+    auto limit = static_cast<juce::uint32>(sampleClock + blockPosition);
+
+    auto isBefore = [](juce::uint32 time, juce::uint32 other) { return static_cast<juce::int32>(time - other) < 0; };
+
+    // One step at a time from whichever voice is due first, so the output is
+    // written in time order; voices due together go in allocation order
+    for (;;)
+    {
+        VoiceAllocator::Voice* due = nullptr;
+        auto anyGliding = false;
+
+        voiceAllocator.forEachActiveVoice([&](VoiceAllocator::Voice& voice)
+        {
+            if (! voice.isGliding())
+                return;
+
+            anyGliding = true;
+
+            if (isBefore(voice.nextGlideStep, limit) && (due == nullptr || isBefore(voice.nextGlideStep, due->nextGlideStep)))
+                due = &voice;
+        });
+
+        if (due == nullptr)
+        {
+            glidesActive = anyGliding;
+            return;
+        }
+
+        stepGlide(*due, static_cast<int>(static_cast<juce::int32>(due->nextGlideStep - blockStart)));
+    }
+}
+
+void TuningEngine::stepGlide(VoiceAllocator::Voice& voice, int position)
+{
+    auto elapsed = static_cast<juce::int32>(voice.nextGlideStep - voice.glideStart);
+    auto progress = juce::jmin(1.0, static_cast<double>(elapsed) / voice.glideLength);
+    auto bend = juce::roundToInt(voice.glideFrom + (voice.glideTarget - voice.glideFrom) * progress);
+
+    if (umpOutput != nullptr)
+    {
+        auto& umpNote = getUmpNote(voice);
+        auto umpBend = static_cast<juce::uint32>(umpNote.glideFrom + ((double) umpNote.glideTarget - umpNote.glideFrom) * progress + 0.5);
+
+        if (umpBend != umpNote.pitchBend)
+        {
+            umpNote.pitchBend = umpBend;
+            voice.pitchBend = static_cast<juce::uint16>(bend);
+            sendPerNoteBend(voice, umpBend, position);
+            reportVoice(VoiceTelemetry::Event::Type::pitchBend, voice, position);
+        }
+    }
+    // Steps that round to the current value are skipped rather than re-sent
+    else if (bend != voice.pitchBend)
+    {
+        voice.pitchBend = static_cast<juce::uint16>(bend);
+        sendPitchWheel(voice.outputChannel, composeBend(bend, voice.inputChannel), position);
+        reportVoice(VoiceTelemetry::Event::Type::pitchBend, voice, position);
+    }
+
+    if (progress >= 1.0)
+        voice.glideLength = 0;
+    else
+        voice.nextGlideStep = voice.glideStart + static_cast<juce::uint32>(juce::jmin(elapsed + glideStepSamples, voice.glideLength));
+}
+
+void TuningEngine::reportVoice(VoiceTelemetry::Event::Type type, const VoiceAllocator::Voice& voice, int samplePosition)
+{
+    VoiceTelemetry::Event event;
+    event.type = type;
+    event.channel = static_cast<juce::uint8>(voice.outputChannel);
+    event.note = static_cast<juce::uint8>(voice.outputNote);
+    event.inputNote = static_cast<juce::uint8>(voice.inputNote);
+    event.pitchBend = static_cast<juce::uint16>(voice.pitchBend);
+    event.samplePosition = samplePosition;
+    telemetry.push(event);
+}
+
+void TuningEngine::send(const juce::MidiMessage& message, int samplePosition)
+{
+    if (umpOutput != nullptr)
+        umpOutput->addMidi1Message(message, samplePosition);
+    else
+        insertEvent(message, samplePosition);
+}
+
+void TuningEngine::insertEvent(const juce::MidiMessage& message, int samplePosition)
+{
+    appendEvent(message.getRawData(), message.getRawDataSize(), samplePosition);
+}
+
+void TuningEngine::keepEvent(const juce::MidiMessage& message, int eventSize, int samplePosition)
+{
+    if (umpOutput != nullptr)
+        umpOutput->addMidi1Message(message, samplePosition);
+    else
+        appendEvent(block->data.begin() + blockCursor + eventHeaderSize, eventSize - eventHeaderSize, samplePosition);
+
+    blockCursor += eventSize;
+}
+
+void TuningEngine::replaceEvent(const juce::MidiMessage& replacement, int eventSize)
+{
+    auto samplePosition = juce::readUnaligned<juce::int32>(block->data.begin() + blockCursor);
+
+    send(replacement, samplePosition);
+    blockCursor += eventSize;
+}
+
+void TuningEngine::dropEvent(int eventSize)
+{
+    blockCursor += eventSize;
+}
+
+void TuningEngine::appendEvent(const juce::uint8* bytes, int numBytes, int samplePosition)
+{
+    if (samplePosition < lastOutputPosition)
+    {
+        // Never happens while glide steps go out in time order, but keeps the block sorted
+        outputBlock.addEvent(bytes, numBytes, samplePosition);
+        ++blockEventsOut;
+        return;
+    }
+
+    auto& data = outputBlock.data;
+    auto offset = data.size();
+
+    // Within the reserve this is a plain copy onto the end
+    data.insertMultiple(offset, 0, eventHeaderSize + numBytes);
+    juce::writeUnaligned<juce::int32>(data.begin() + offset, samplePosition);
+    juce::writeUnaligned<juce::uint16>(data.begin() + offset + sizeof(juce::int32), static_cast<juce::uint16>(numBytes));
+    std::memcpy(data.begin() + offset + eventHeaderSize, bytes, (size_t) numBytes);
+
+    lastOutputPosition = samplePosition;
+    ++blockEventsOut;
+}
+
+void TuningEngine::sendPitchWheel(int channel, int pitchBend, int samplePosition)
+{
+    channelBends[(size_t) channel] = static_cast<juce::int16>(pitchBend);
+    numBendsSent.add();
+    insertEvent(juce::MidiMessage::pitchWheel(channel + 1, pitchBend), samplePosition);
+}
+
+int TuningEngine::composeBend(int tuningBend, int inputChannel) const
+{
+    auto cents = performerCents[(size_t) inputChannel];
+
+    // A centred wheel, the common case, leaves the tuning bend exactly as it was
+    if (cents == 0.0)
+        return tuningBend;
+
+    return juce::jlimit(0, 16383, juce::roundToInt(tuningBend + cents / outputCentsPerStep));
+}
+
+void TuningEngine::applyPerformerBend(int inputChannel, int samplePosition)
+{
+    if (umpOutput != nullptr)
+    {
+        // MIDI 2.0 never rotates, and receivers add the channel bend to each note's
+        // own pitch, so the wheel only needs rescaling to the output range
+        auto bend = composeBend(8192, inputChannel);
+
+        if (channelBends[(size_t) inputChannel] != bend)
+        {
+            channelBends[(size_t) inputChannel] = static_cast<juce::int16>(bend);
+            send(juce::MidiMessage::pitchWheel(inputChannel + 1, bend), samplePosition);
         }
+
+        return;
+    }
+
+    // As in retuneHeldVoices(), the newest voice on an output channel owns its wheel
+    std::array<VoiceAllocator::Voice*, 16> channelOwners {};
+
+    voiceAllocator.forEachActiveVoice([&](VoiceAllocator::Voice& voice)
+    {
+        channelOwners[(size_t) voice.outputChannel] = &voice;
+    });
+
+    for (auto* voice : channelOwners)
+    {
+        if (voice == nullptr || voice->inputChannel != inputChannel)
+            continue;
+
+        auto bend = composeBend(voice->pitchBend, inputChannel);
+
+        if (channelBends[(size_t) voice->outputChannel] != bend)
+            sendPitchWheel(voice->outputChannel, bend, samplePosition);
     }
+}
+
+void TuningEngine::sendUmpNoteOn(const TuningState& state, const VoiceAllocator::Voice& voice, double pitch, int velocity, int samplePosition)
+{
+    auto& umpNote = getUmpNote(voice);
+    auto header = Ump::makeHeader(0x9, voice.outputChannel, voice.outputNote, 0);
+    auto velocityWord = Ump::scaleUp((juce::uint32) velocity, 7, 16) << 16;
+
+    if (renderedProtocol == OutputProtocol::midi2PitchAttribute)
+    {
+        // A bend left over from an earlier note on this key would offset the new pitch
+        if (umpNote.pitchBend != Ump::centreValue)
+            sendPerNoteBend(voice, Ump::centreValue, samplePosition);
 
-    midiMessages.swapWith(processedMidi);
+        umpNote.basePitch = Ump::toPitch7_9(pitch);
+        umpNote.pitchBend = Ump::centreValue;
+        umpOutput->add(samplePosition, header | Ump::pitchAttribute, velocityWord | umpNote.basePitch);
+    }
+    else
+    {
+        // Ahead of the note-on, as the MIDI 1.0 path does with channel bends
+        umpNote.basePitch = Ump::toPitch7_9(voice.outputNote);
+        umpNote.pitchBend = calculatePerNoteBend((pitch - voice.outputNote) * 100.0, state.pitchBendRange);
+        sendPerNoteBend(voice, umpNote.pitchBend, samplePosition);
+        umpOutput->add(samplePosition, header, velocityWord);
+    }
+}
+
+void TuningEngine::sendPerNoteBend(const VoiceAllocator::Voice& voice, juce::uint32 pitchBend, int samplePosition)
+{
+    numBendsSent.add();
+    umpOutput->add(samplePosition, Ump::makeHeader(0x6, voice.outputChannel, voice.outputNote, 0), pitchBend);
 }
 
 void TuningEngine::reset()
 {
-    for (auto& channel : activeNotes)
-        for (auto& note : channel)
-            note = ActiveNote{};
+    voiceAllocator.reset();
+    heldNotes.clear();
+    channelBends.fill(-1);
 }
@@ -2,6 +2,15 @@
 
 #include <JuceHeader.h>
 #include <array>
+#include <atomic>
+#include "TripleBuffer.h"
+#include "VoiceAllocator.h"
+#include "VoiceTelemetry.h"
+#include "HeldNoteSet.h"
+#include "RetuningStrategy.h"
+#include "SharedTable.h"
+#include "UmpBuffer.h"
+#include "BlockStats.h"
 
 /**
  * TuningEngine - Core tuning logic for MIDI processing
@@ -12,42 +21,460 @@
 class TuningEngine
 {
 public:
+    // How the key sent to the synth is chosen for each incoming note
+    enum class NoteMapping
+    {
+        sameKey,        // play the incoming key and bend by the full cents deviation
+        nearestKey      // play the 12TET key closest to the target pitch, bend only the rest
+    };
+
+    // What happens to sounding notes when the table changes under them
+    enum class HeldNoteRetune
+    {
+        off,            // keep the bend they started with
+        immediate,      // send the new bend at the start of the next block
+        glide           // move to the new bend over the glide time
+    };
+
+    // Wire protocol of the output. The MIDI 2.0 modes give every note its own
+    // pitch, so notes stay on their input channel and the voice allocation
+    // setting is ignored. Per-note bends use the pitch bend range, which must
+    // match the destination's per-note pitch bend sensitivity.
+    enum class OutputProtocol
+    {
+        midi1,                  // pitch wheel + note-on, one voice per channel
+        midi2PitchAttribute,    // one note-on carrying pitch 7.9 (~0.2 cent steps)
+        midi2PerNoteBend        // 32-bit per-note pitch bend + note-on
+    };
+
     TuningEngine();
     ~TuningEngine() = default;
 
-    // Process MIDI buffer, applying tuning
-    void processBlock(juce::MidiBuffer& midiMessages);
+    // Size the output reservation so processBlock doesn't allocate (call from prepareToPlay)
+    void prepare(double sampleRate, int samplesPerBlock);
+
+    // Process MIDI buffer, applying tuning. A block with no notes, pitch wheel,
+    // preset switch or glide in it is left untouched; any other is written out
+    // once into a buffer reserved by prepare() and copied back. Ordering guarantees:
+    //  - Output keeps input order. What the engine adds for an input event goes at
+    //    that event's sample position, ahead of the event or in its place.
+    //  - A note's bend always precedes its note-on, at the same sample position.
+    //    It is left out only when the channel's last bend already has that value.
+    //  - Incoming pitch wheels are consumed. They move every voice playing from
+    //    that channel, whose combined bends go out at the wheel's position.
+    void processBlock(juce::MidiBuffer& midiMessages, int numSamples);
+
+    // For a destination that takes Universal MIDI Packets. Under a MIDI 2.0
+    // protocol the input is consumed and the output written to umpOutput (size it
+    // for twice getMaxEventsPerBlock()); otherwise, or with umpOutput == nullptr,
+    // this is the MIDI 1.0 path above. Each destination can fall back on its own.
+    void processBlock(juce::MidiBuffer& midiMessages, int numSamples, UmpBuffer* umpOutput);
+
+    // Upper bound on events per block; prepare() reserves the engine's output for it
+    void setMaxEventsPerBlock(int numEvents);
+    int getMaxEventsPerBlock() const { return maxEventsPerBlock; }
+
+    // Bytes of MIDI output prepare() reserved, for buffers that must take a block's output
+    size_t getReservedOutputBytes() const { return reservedOutputBytes; }
+
+    // Number of blocks that had to grow the MIDI or UMP buffer
+    int getNumOutputReallocations() const { return numOutputReallocations.load(); }
 
-    // Set tuning table (128 entries, cents deviation per note)
+    // Voice bends sent and voices taken from another note, since construction.
+    // Always 0 when built with TUNING_MIDDLEWARE_BLOCK_STATS=0.
+    juce::int64 getNumBendsSent() const { return numBendsSent.get(); }
+    juce::int64 getNumVoiceSteals() const { return numVoiceSteals.get(); }
+
+    // Set tuning table (128 entries, cents deviation per note) of the selected preset.
+    // Safe to call from any non-audio thread; takes effect at the next block.
+    // The getters below take the same lock, so they may be called from any
+    // non-audio thread too, but not from a state listener.
     void setTuningTable(const std::array<float, 128>& cents);
-    const std::array<float, 128>& getTuningTable() const { return tuningTable; }
 
-    // Set pitch bend range in semitones
+    // The table playing now: the shared one while there is one, else the current preset's
+    std::array<float, 128> getTuningTable() const;
+
+    // Overwrite only the listed notes, leaving the rest of the table as it is
+    void setTuningEntries(const juce::uint8* notes, const float* cents, int numEntries);
+
+    // Preset bank. Every table is preloaded with its bends precomputed, so a
+    // switch is an index change on the audio thread. Held voices follow the
+    // held-note retune mode, just as they do for a table edit.
+    static constexpr int maxPresets = 16;
+
+    void setPresetTable(int index, const std::array<float, 128>& cents);
+    std::array<float, 128> getPresetTable(int index) const;
+
+    // Fill the selected preset's table from two others: a linear morph by amount
+    // (0 = from, 1 = to), then a stretch about A4 and a transposition in cents.
+    // Vector operations over the 128 entries, so it can run once per UI frame.
+    // Either source may be the selected preset, read as it was before the call.
+    // False when either source is out of range.
+    bool setTuningFromPresets(int from, int to, float amount, float stretch = 1.0f, float transposeCents = 0.0f);
+
+    // The same table written into cents, leaving the presets as they are
+    bool getTuningFromPresets(int from, int to, float amount, float stretch, float transposeCents,
+                              std::array<float, 128>& cents) const;
+
+    // Takes effect at the next block
+    void selectPreset(int index);
+
+    // A table several engines play, such as a tuning group's. While one is set it
+    // plays whichever preset is selected, and the audio thread picks up what is
+    // published to it at the start of each block, with no edit to this engine.
+    // Clearing it leaves its table in the current preset, so nothing changes audibly.
+    void setSharedTable(SharedTable::Ptr table);
+    SharedTable::Ptr getSharedTable() const { return readState(&TuningState::sharedTable); }
+
+    // Serial of the shared table's newest table, 0 without one
+    juce::uint32 getSharedTableSerial() const;
+
+    // The preset playing now, including switches made by incoming MIDI
+    int getCurrentPreset() const;
+
+    // Frequency set mode, for pitches that don't map one to one onto keys. Each
+    // note-on plays the pitch in the set nearest to the key's tuned pitch (so
+    // with a 12TET preset, nearest to the key itself). All math is in double.
+    // An empty set returns to plain table tuning.
+    static constexpr int maxFrequencies = 512;
+
+    void setFrequencySet(const double* frequenciesHz, int numFrequencies);
+    int getNumFrequencies() const { return readState(&TuningState::numPitches); }
+    void getFrequencySet(juce::Array<double>& frequenciesHz) const;
+
+    // Dynamic tuning. The strategy picks each new note's pitch from the notes
+    // already sounding; nullptr returns to static tuning. While one is set, held
+    // voices keep the pitch they were given when the table changes.
+    void setRetuningStrategy(RetuningStrategy::Ptr strategy);
+    RetuningStrategy::Ptr getRetuningStrategy() const { return readState(&TuningState::retuningStrategy); }
+
+    // Which incoming MIDI selects presets; such messages are consumed.
+    // A controller of -1 disables CC selection.
+    void setPresetSwitching(bool useProgramChange, int controllerNumber);
+    bool getPresetSwitchesOnProgramChange() const { return readState(&TuningState::presetProgramChange); }
+    int getPresetController() const { return readState(&TuningState::presetController); }
+
+    // Set pitch bend range in semitones (same threading rules as above)
     void setPitchBendRange(float semitones);
-    float getPitchBendRange() const { return pitchBendRange; }
+    float getPitchBendRange() const { return readState(&TuningState::pitchBendRange); }
+
+    // Range of the performer's incoming pitch wheel in semitones (0 ignores it).
+    // Each voice plays its tuning offset plus the wheel of the channel it came in on.
+    void setInputPitchBendRange(float semitones);
+    float getInputPitchBendRange() const { return readState(&TuningState::inputPitchBendRange); }
+
+    // Replace table and range together so no block sees one without the other
+    void setTuning(const std::array<float, 128>& cents, float pitchBendSemitones);
+
+    // nearestKey keeps bends within +/-50 cents, so a +/-2 semitone range suffices
+    void setNoteMapping(NoteMapping mapping);
+    NoteMapping getNoteMapping() const { return readState(&TuningState::noteMapping); }
+
+    // Only voices whose bend actually changes are sent a new pitch wheel
+    void setHeldNoteRetune(HeldNoteRetune mode, float glideMilliseconds);
+    HeldNoteRetune getHeldNoteRetune() const { return readState(&TuningState::heldNoteRetune); }
+    float getRetuneGlideMilliseconds() const { return readState(&TuningState::retuneGlideMs); }
+
+    // Audio thread: whether a voice may still be gliding after the last block.
+    // Clears in the first block after the final step.
+    bool hasActiveGlides() const { return glidesActive; }
+
+    // Takes effect at the next block; sounding voices are released first
+    void setOutputProtocol(OutputProtocol protocol);
+    OutputProtocol getOutputProtocol() const { return readState(&TuningState::outputProtocol); }
+
+    // Choose how notes are spread over output channels. Changing it releases
+    // all sounding voices at the start of the next block.
+    void setVoiceAllocation(const VoiceAllocator::Config& config);
+    VoiceAllocator::Config getVoiceAllocation() const { return readState(&TuningState::voiceAllocation); }
+
+    // Everything a saved session restores. Copying one never allocates.
+    struct SavedState
+    {
+        std::array<std::array<float, 128>, maxPresets> presets {};
+        int selectedPreset = 0;
+
+        bool presetProgramChange = true;
+        int presetController = -1;
+        std::array<double, maxFrequencies> frequenciesHz {};    // ascending
+        int numFrequencies = 0;
+        RetuningStrategy::Ptr retuningStrategy;
+
+        float pitchBendRange = 48.0f;
+        float inputPitchBendRange = 2.0f;
+        NoteMapping noteMapping = NoteMapping::sameKey;
+        HeldNoteRetune heldNoteRetune = HeldNoteRetune::off;
+        float retuneGlideMs = 20.0f;
+        OutputProtocol outputProtocol = OutputProtocol::midi1;
+        VoiceAllocator::Config voiceAllocation;
+
+        // The edit the copy was taken at; restoreState() ignores it
+        juce::uint32 serial = 0;
+    };
+
+    // Replaces the whole state as one edit, so no block (or listener) sees part
+    // of it. Values are limited as the individual setters limit them.
+    void restoreState(const SavedState& saved);
+
+    // The whole state at one edit, under the writer lock, for saving. Fields read
+    // with the getters one by one may each come from a different edit.
+    void copyState(SavedState& dest) const;
+
+    // Frequency in Hz each key plays under a state's selected preset, frequency
+    // set included. Dynamic tuning picks pitches per chord, so it isn't reflected.
+    static void getKeyFrequencies(const SavedState& state, std::array<double, 128>& frequenciesHz);
+
+    // Voice events written by processBlock, for the UI to drain
+    VoiceTelemetry& getTelemetry() { return telemetry; }
+
+    // Told about every published edit, on the editing thread and with the writer
+    // lock held, so a listener must neither edit the engine nor call its getters;
+    // it is given the state instead. Each edit gets the next serial; the audio
+    // thread reports which one it plays. Preset switches made by incoming MIDI
+    // aren't edits and aren't reported.
+    class StateListener
+    {
+    public:
+        virtual ~StateListener() = default;
+
+        virtual void tuningStatePublished(const SavedState& state) = 0;
+    };
+
+    // Not from the audio thread. Once removeStateListener() returns, the listener
+    // is no longer being called. With notifyNow it is also called straight away
+    // for the current serial, under the same lock, so a starting snapshot can't
+    // miss an edit or see half of one.
+    void addStateListener(StateListener* listener, bool notifyNow = false);
+    void removeStateListener(StateListener* listener);
+
+    // The serial of the newest edit
+    juce::uint32 getStateSerial() const { return readState(&TuningState::serial); }
+
+    // Audio thread, after processBlock: the serial of the edit the block played
+    // and the preset it started on, so a capture can replay both
+    juce::uint32 getBlockStateSerial() const { return stateExchange.getReadBuffer().serial; }
+    int getBlockStartPreset() const { return blockStartPreset; }
+
+    // Audio thread, after processBlock: the shared table the block played, or
+    // nullptr, and the serial it was published with
+    const std::array<float, 128>* getBlockSharedTable() const
+    {
+        return stateExchange.getReadBuffer().sharedTable != nullptr ? &sharedMap.tuningTable : nullptr;
+    }
+
+    juce::uint32 getBlockSharedTableSerial() const { return sharedTableSerial; }
+
+    // Audio thread, after processBlock: events the block was given and events it
+    // wrote (UMP packets when it rendered MIDI 2.0), counted as it went
+    int getBlockEventsIn() const { return blockEventsIn; }
+    int getBlockEventsOut() const { return blockEventsOut; }
 
     // Reset all active notes
     void reset();
 
 private:
+    // One preset: its table plus what rebuildNoteMap() derives from it
+    struct NoteMap
+    {
+        // Tuning table: cents deviation for each MIDI note (0-127)
+        std::array<float, 128> tuningTable {};
+
+        // Never edited directly
+        std::array<juce::uint16, 128> pitchBends {};
+        std::array<juce::uint8, 128> outputNotes {};
+    };
+
+    // Everything the audio thread reads that is written from other threads
+    struct TuningState
+    {
+        std::array<NoteMap, maxPresets> presets {};
+
+        bool presetProgramChange = true;
+        int presetController = -1;
+
+        // Frequency set as fractional MIDI note numbers, sorted ascending
+        std::array<double, maxFrequencies> pitchSet {};
+        int numPitches = 0;
+
+        // Pitch bend range in semitones (must match target instrument)
+        float pitchBendRange = 48.0f;
+        float inputPitchBendRange = 2.0f;
+
+        NoteMapping noteMapping = NoteMapping::sameKey;
+        VoiceAllocator::Config voiceAllocation;
+        OutputProtocol outputProtocol = OutputProtocol::midi1;
+
+        HeldNoteRetune heldNoteRetune = HeldNoteRetune::off;
+        float retuneGlideMs = 20.0f;
+
+        // Released on the writer thread when its last state copy is overwritten
+        RetuningStrategy::Ptr retuningStrategy;
+        SharedTable::Ptr sharedTable;
+
+        // Advanced by every publish
+        juce::uint32 serial = 0;
+    };
+
     // Calculate 14-bit pitch bend value for a given cents deviation
-    int calculatePitchBend(float cents) const;
+    static int calculatePitchBend(double cents, float pitchBendRange);
+
+    // 32-bit MIDI 2.0 equivalent, for per-note pitch bend
+    static juce::uint32 calculatePerNoteBend(double cents, float pitchBendRange);
+
+    // Output key and bend for a note-on under the given state and preset; returns
+    // the pitch played as a fractional MIDI note
+    static double resolveNote(const TuningState& state, const NoteMap& map, int note, int& outputNote, int& pitchBend);
+
+    // Converts positive, finite frequencies into the state's sorted pitch set
+    static void storeFrequencySet(TuningState& state, const double* frequenciesHz, int numFrequencies);
+
+    // Entry of the frequency set closest to a pitch (fractional MIDI note)
+    static double findNearestPitch(const TuningState& state, double pitch);
 
-    // Tuning table: cents deviation for each MIDI note (0-127)
-    std::array<float, 128> tuningTable;
+    // Recompute the per-note bend and output note tables of every preset
+    static void rebuildNoteMap(TuningState& state);
+    static void rebuildNoteMap(NoteMap& preset, const TuningState& state);
 
-    // Pitch bend range in semitones (must match target instrument)
-    float pitchBendRange = 48.0f;
+    // Copy editState into the exchange; the audio thread adopts it next block.
+    // An edit to one preset's table passes its index so only that one is rebuilt.
+    void publishState(int changedPreset = -1);
 
-    // Track active notes per channel for proper note-off handling
-    struct ActiveNote
+    // Caller holds writerLock
+    void copyEditState(SavedState& dest) const;
+
+    // Reads a field of editState under writerLock, for the getters
+    template <typename Field>
+    Field readState(Field TuningState::* field) const
     {
-        int originalNote = -1;
-        int outputNote = -1;
-        int pitchBend = 8192;
+        const juce::SpinLock::ScopedLockType lock(writerLock);
+        return editState.*field;
+    }
+
+    // Send note-offs for every sounding voice and forget them
+    void releaseAllVoices(int samplePosition);
+
+    // Diff a newly adopted table against the sounding voices
+    void retuneHeldVoices(const TuningState& state, int samplePosition);
+
+    // MIDI 2.0 version: every voice bends on its own, so none is left out
+    void retuneUmpVoices(const TuningState& state, int samplePosition);
+
+    // Audio thread: switch to a preset in response to MIDI or selectPreset()
+    void switchPreset(const TuningState& state, int index, int samplePosition);
+
+    // Audio thread: the table notes play from, the shared one while there is one
+    const NoteMap& getPlayingMap(const TuningState& state) const
+    {
+        return state.sharedTable != nullptr ? sharedMap : state.presets[(size_t) currentPreset];
+    }
+
+    // Emit due glide steps up to (not including) the given sample position
+    void advanceGlides(int blockPosition);
+    void stepGlide(VoiceAllocator::Voice& voice, int samplePosition);
+
+    // Bend a held voice needs under the given state and preset, keeping its output key
+    static int getHeldVoiceBend(const VoiceAllocator::Voice& voice, const TuningState& state, const NoteMap& map);
+
+    void reportVoice(VoiceTelemetry::Event::Type type, const VoiceAllocator::Voice& voice, int samplePosition);
+
+    // Writes a MIDI 1.0 message to this block's output, translated when it is MIDI 2.0
+    void send(const juce::MidiMessage& message, int samplePosition);
+
+    // MIDI 1.0 only; records the bend so note-ons can skip repeating it
+    void sendPitchWheel(int channel, int pitchBend, int samplePosition);
+
+    // A voice's tuning bend with the performer's wheel on its input channel added
+    int composeBend(int tuningBend, int inputChannel) const;
+
+    // Re-sends the bends of the voices playing from an input channel after its wheel moved
+    void applyPerformerBend(int inputChannel, int samplePosition);
+
+    // Writing an edited block around the input event at blockCursor. Inserts go
+    // out ahead of it; the others consume it and move the cursor to the next one.
+    void insertEvent(const juce::MidiMessage& message, int samplePosition);
+    void keepEvent(const juce::MidiMessage& message, int eventSize, int samplePosition);
+    void replaceEvent(const juce::MidiMessage& replacement, int eventSize);
+    void dropEvent(int eventSize);
+    void appendEvent(const juce::uint8* bytes, int numBytes, int samplePosition);
+
+    // False when the block can pass as it is
+    bool blockNeedsEditing(const juce::MidiBuffer& midiMessages, const TuningState& state);
+
+    void sendUmpNoteOn(const TuningState& state, const VoiceAllocator::Voice& voice, double pitch, int velocity, int samplePosition);
+    void sendPerNoteBend(const VoiceAllocator::Voice& voice, juce::uint32 pitchBend, int samplePosition);
+
+    // Writer-side copy, guarded by writerLock
+    TuningState editState;
+    mutable juce::SpinLock writerLock;
+    juce::Array<StateListener*> stateListeners;
+    SavedState listenerState;
+
+    TripleBuffer<TuningState> stateExchange;
+
+    // selectPreset() posts here (-1 when nothing is pending); the audio thread owns
+    // currentPreset and mirrors it to playingPreset for other threads
+    std::atomic<int> requestedPreset { -1 };
+    std::atomic<int> playingPreset { 0 };
+    int currentPreset = 0;
+    int blockStartPreset = 0;
+
+    // The shared table as the audio thread last read it, rebuilt with the state's settings
+    NoteMap sharedMap;
+    juce::uint32 sharedTableSerial = 0;
+
+    // Sounding voices, owned by the audio thread
+    VoiceAllocator voiceAllocator;
+    HeldNoteSet heldNotes;
+    VoiceTelemetry telemetry;
+
+    // Glide timing, in samples
+    double currentSampleRate = 44100.0;
+    juce::int64 sampleClock = 0;
+    int glideStepSamples = 44;
+    bool glidesActive = false;
+
+    // What the MIDI 2.0 destination was last told about each output channel and
+    // key. Receivers keep per-note bends past note-off, so entries outlive voices.
+    struct UmpNote
+    {
+        juce::uint16 basePitch = 0;                 // 7.9 pitch set by the note-on
+        juce::uint32 pitchBend = Ump::centreValue;  // relative to basePitch
+        juce::uint32 glideFrom = Ump::centreValue;
+        juce::uint32 glideTarget = Ump::centreValue;
     };
-    
-    std::array<std::array<ActiveNote, 128>, 16> activeNotes;
+
+    UmpNote& getUmpNote(const VoiceAllocator::Voice& voice)
+    {
+        return umpNotes[(size_t) voice.outputChannel][(size_t) voice.outputNote];
+    }
+
+    // Last pitch wheel sent on each output channel, -1 when the receiver's is unknown
+    std::array<juce::int16, 16> channelBends;
+
+    // The performer's wheel per input channel in cents, and this block's step sizes.
+    // Voices keep their tuning bend alone; the wheel is added whenever one is sent.
+    std::array<double, 16> performerCents {};
+    double inputCentsPerStep = 0.0;
+    double outputCentsPerStep = 0.0;
+
+    // This block's MIDI 2.0 destination, nullptr while rendering MIDI 1.0
+    UmpBuffer* umpOutput = nullptr;
+    OutputProtocol renderedProtocol = OutputProtocol::midi1;
+    std::array<std::array<UmpNote, 128>, 16> umpNotes {};
+
+    // The buffer being processed and the byte offset of its current event
+    juce::MidiBuffer* block = nullptr;
+    int blockCursor = 0;
+
+    // An edited block's output, copied over the host's buffer at the end. Reserved
+    // in prepare() to reservedOutputBytes, so the audio thread only appends to it.
+    juce::MidiBuffer outputBlock;
+    int lastOutputPosition = 0;
+    int blockEventsIn = 0, blockEventsOut = 0;
+    size_t reservedOutputBytes = 0;
+    int maxEventsPerBlock = 1024;
+    std::atomic<int> numOutputReallocations { 0 };
+    BlockStats::Counter numBendsSent, numVoiceSteals;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(TuningEngine)
 };
@@ -0,0 +1,65 @@
+#include "TuningGroups.h"
+#include <map>
+
+namespace
+{
+    struct Group
+    {
+        SharedTable::Ptr table;
+        int numMembers = 0;
+    };
+
+    // One per process, so every plugin instance loaded by a host shares it. The
+    // lock only guards the map; tables are published to without it.
+    struct Registry
+    {
+        juce::CriticalSection lock;
+        std::map<juce::String, Group> groups;
+
+        static Registry& get()
+        {
+            static Registry registry;
+            return registry;
+        }
+    };
+}
+
+SharedTable::Ptr TuningGroups::join(const juce::String& groupId, const std::array<float, 128>& currentCents)
+{
+    if (groupId.isEmpty())
+        return nullptr;
+
+    auto& registry = Registry::get();
+    const juce::ScopedLock lock(registry.lock);
+
+    auto& group = registry.groups[groupId];
+    ++group.numMembers;
+
+    if (group.table == nullptr)
+        group.table = new SharedTable(currentCents);
+
+    return group.table;
+}
+
+void TuningGroups::leave(const juce::String& groupId)
+{
+    auto& registry = Registry::get();
+    const juce::ScopedLock lock(registry.lock);
+
+    auto group = registry.groups.find(groupId);
+    if (group == registry.groups.end())
+        return;
+
+    // The table goes with the last member, so a group id can be reused afresh
+    if (--group->second.numMembers <= 0)
+        registry.groups.erase(group);
+}
+
+int TuningGroups::getNumMembers(const juce::String& groupId)
+{
+    auto& registry = Registry::get();
+    const juce::ScopedLock lock(registry.lock);
+
+    auto group = registry.groups.find(groupId);
+    return group != registry.groups.end() ? group->second.numMembers : 0;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include "SharedTable.h"
+
+/**
+ * TuningGroups - Tuning shared by every instance in the process that joins a group
+ *
+ * A group is one SharedTable. Members hand it to their TuningEngine, and an edit
+ * published to it is one snapshot swap whatever the number of members: their
+ * audio threads pick it up lock-free at their next block, and nothing is called
+ * on them. One parse for N instances and no IPC.
+ *
+ * All calls are for non-audio threads.
+ */
+class TuningGroups
+{
+public:
+    // Joins a group and returns its table; a group nobody is in yet starts from
+    // currentCents. An empty id joins nothing and returns nullptr.
+    static SharedTable::Ptr join(const juce::String& groupId, const std::array<float, 128>& currentCents);
+
+    // Once per join, before the member is destroyed
+    static void leave(const juce::String& groupId);
+
+    static int getNumMembers(const juce::String& groupId);
+};
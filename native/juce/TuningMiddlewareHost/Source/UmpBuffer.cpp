@@ -0,0 +1,91 @@
+#include "UmpBuffer.h"
+
+namespace
+{
+    // MIDI 1.0 note-offs carry no real release velocity, so 64 stands in for one
+    constexpr int defaultReleaseVelocity = 64;
+
+    void addSysEx(UmpBuffer& buffer, const juce::uint8* data, int size, int samplePosition)
+    {
+        // Data 64 packets (message type 3) carry up to six bytes each
+        for (int offset = 0; offset < size || offset == 0; offset += 6)
+        {
+            auto numBytes = juce::jmin(6, size - offset);
+            auto isFirst = offset == 0;
+            auto isLast = offset + 6 >= size;
+            auto status = isFirst ? (isLast ? 0x0 : 0x1) : (isLast ? 0x3 : 0x2);
+
+            std::array<juce::uint8, 6> bytes {};
+            for (int i = 0; i < numBytes; ++i)
+                bytes[(size_t) i] = data[offset + i] & 0x7f;
+
+            buffer.add(samplePosition,
+                       (0x3u << 28) | ((juce::uint32) status << 20) | ((juce::uint32) numBytes << 16)
+                           | ((juce::uint32) bytes[0] << 8) | bytes[1],
+                       ((juce::uint32) bytes[2] << 24) | ((juce::uint32) bytes[3] << 16)
+                           | ((juce::uint32) bytes[4] << 8) | bytes[5]);
+        }
+    }
+}
+
+void UmpBuffer::addMidi1Message(const juce::MidiMessage& message, int samplePosition)
+{
+    auto channel = message.getChannel() - 1;
+
+    if (message.isSysEx())
+    {
+        addSysEx(*this, message.getSysExData(), message.getSysExDataSize(), samplePosition);
+        return;
+    }
+
+    if (channel < 0)
+    {
+        // System common and real-time messages (message type 1) keep their bytes
+        auto* data = message.getRawData();
+        auto size = message.getRawDataSize();
+
+        add(samplePosition, (0x1u << 28) | ((juce::uint32) data[0] << 16)
+                                | (size > 1 ? (juce::uint32) data[1] << 8 : 0u)
+                                | (size > 2 ? (juce::uint32) data[2] : 0u));
+        return;
+    }
+
+    if (message.isNoteOn())
+    {
+        add(samplePosition, Ump::makeHeader(0x9, channel, message.getNoteNumber(), 0),
+            Ump::scaleUp((juce::uint32) message.getVelocity(), 7, 16) << 16);
+    }
+    else if (message.isNoteOff())
+    {
+        // Note-on with velocity 0 lands here too
+        auto velocity = message.isNoteOff(false) ? message.getVelocity() : defaultReleaseVelocity;
+        add(samplePosition, Ump::makeHeader(0x8, channel, message.getNoteNumber(), 0),
+            Ump::scaleUp((juce::uint32) velocity, 7, 16) << 16);
+    }
+    else if (message.isAftertouch())
+    {
+        add(samplePosition, Ump::makeHeader(0xa, channel, message.getNoteNumber(), 0),
+            Ump::scaleUp((juce::uint32) message.getAfterTouchValue(), 7, 32));
+    }
+    else if (message.isController())
+    {
+        // RPN/NRPN sequences stay as plain controllers rather than being merged
+        add(samplePosition, Ump::makeHeader(0xb, channel, message.getControllerNumber(), 0),
+            Ump::scaleUp((juce::uint32) message.getControllerValue(), 7, 32));
+    }
+    else if (message.isProgramChange())
+    {
+        add(samplePosition, Ump::makeHeader(0xc, channel, 0, 0),
+            (juce::uint32) message.getProgramChangeNumber() << 24);
+    }
+    else if (message.isChannelPressure())
+    {
+        add(samplePosition, Ump::makeHeader(0xd, channel, 0, 0),
+            Ump::scaleUp((juce::uint32) message.getChannelPressureValue(), 7, 32));
+    }
+    else if (message.isPitchWheel())
+    {
+        add(samplePosition, Ump::makeHeader(0xe, channel, 0, 0),
+            Ump::scaleUp((juce::uint32) message.getPitchWheelValue(), 14, 32));
+    }
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+
+/**
+ * UmpBuffer - Universal MIDI Packets with sample positions, for MIDI 2.0 output
+ *
+ * juce::MidiBuffer only carries MIDI 1.0 bytes, so the engine's MIDI 2.0 output
+ * goes here instead. Packets are kept in time order in one flat array; after
+ * ensureSize() adding to it doesn't allocate.
+ */
+class UmpBuffer
+{
+public:
+    struct Event
+    {
+        int samplePosition = 0;
+        int numWords = 0;                       // 1 or 2; nothing we send is longer
+        std::array<juce::uint32, 2> words {};
+    };
+
+    void ensureSize(int numEvents) { events.ensureStorageAllocated(numEvents); }
+    void clear() { events.clearQuick(); }
+
+    // Keeps time order; packets at the same position stay in the order added
+    void add(int samplePosition, juce::uint32 word0)                        { insert({ samplePosition, 1, { word0, 0 } }); }
+    void add(int samplePosition, juce::uint32 word0, juce::uint32 word1)    { insert({ samplePosition, 2, { word0, word1 } }); }
+
+    // Translates a MIDI 1.0 message to MIDI 2.0 protocol packets on group 0
+    void addMidi1Message(const juce::MidiMessage& message, int samplePosition);
+
+    int getNumEvents() const { return events.size(); }
+    int getNumAllocated() const { return events.getNumAllocated(); }
+    bool isEmpty() const { return events.isEmpty(); }
+
+    const Event* begin() const { return events.begin(); }
+    const Event* end() const { return events.end(); }
+
+private:
+    void insert(const Event& event)
+    {
+        auto index = events.size();
+
+        // Output is almost always added in order, so search from the back
+        while (index > 0 && events.getReference(index - 1).samplePosition > event.samplePosition)
+            --index;
+
+        events.insert(index, event);
+    }
+
+    juce::Array<Event> events;
+};
+
+/**
+ * Ump - MIDI 2.0 channel voice packets (message type 4) on group 0
+ */
+namespace Ump
+{
+    // Note attribute type carrying pitch as 7.9 fixed point semitones
+    constexpr juce::uint8 pitchAttribute = 3;
+
+    constexpr juce::uint32 centreValue = 0x80000000u;
+
+    constexpr juce::uint32 makeHeader(int status, int channel, int byte3, int byte4)
+    {
+        return (0x4u << 28) | ((juce::uint32) (status & 0xf) << 20) | ((juce::uint32) (channel & 0xf) << 16)
+             | ((juce::uint32) (byte3 & 0xff) << 8) | (juce::uint32) (byte4 & 0xff);
+    }
+
+    // Min-centre-max upscaling from the MIDI 2.0 translation rules, so 0, centre and max map exactly
+    constexpr juce::uint32 scaleUp(juce::uint32 value, int sourceBits, int destinationBits)
+    {
+        auto scaleBits = destinationBits - sourceBits;
+        auto shifted = value << scaleBits;
+        auto sourceCentre = 1u << (sourceBits - 1);
+
+        if (value <= sourceCentre)
+            return shifted;
+
+        auto repeatBits = sourceBits - 1;
+        auto repeatValue = value & ((1u << repeatBits) - 1);
+        repeatValue = scaleBits > repeatBits ? repeatValue << (scaleBits - repeatBits)
+                                             : repeatValue >> (repeatBits - scaleBits);
+
+        while (repeatValue != 0)
+        {
+            shifted |= repeatValue;
+            repeatValue >>= repeatBits;
+        }
+
+        return shifted;
+    }
+
+    // Pitch as a fractional MIDI note, clamped to what 7.9 can hold
+    inline juce::uint16 toPitch7_9(double pitch)
+    {
+        return static_cast<juce::uint16>(juce::jlimit(0, 0xffff, juce::roundToInt(pitch * 512.0)));
+    }
+
+    inline double fromPitch7_9(juce::uint16 pitch) { return pitch / 512.0; }
+}
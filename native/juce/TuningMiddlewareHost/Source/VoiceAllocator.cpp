@@ -0,0 +1,178 @@
+#include "VoiceAllocator.h"
+
+//==============================================================================
+template <size_t size>
+void VoiceAllocator::LinkedList<size>::clear()
+{
+    for (auto index = head; index >= 0;)
+    {
+        auto next = links[(size_t) index].next;
+        links[(size_t) index] = Link{};
+        index = next;
+    }
+
+    head = tail = -1;
+}
+
+template <size_t size>
+void VoiceAllocator::LinkedList<size>::pushBack(int index)
+{
+    auto& link = links[(size_t) index];
+    link.previous = static_cast<juce::int8>(tail);
+    link.next = -1;
+
+    if (tail >= 0)
+        links[(size_t) tail].next = static_cast<juce::int8>(index);
+    else
+        head = index;
+
+    tail = index;
+}
+
+template <size_t size>
+void VoiceAllocator::LinkedList<size>::remove(int index)
+{
+    auto& link = links[(size_t) index];
+
+    if (link.previous >= 0)
+        links[(size_t) link.previous].next = link.next;
+    else
+        head = link.next;
+
+    if (link.next >= 0)
+        links[(size_t) link.next].previous = link.previous;
+    else
+        tail = link.previous;
+
+    link = Link{};
+}
+
+//==============================================================================
+VoiceAllocator::VoiceAllocator()
+{
+    reset();
+}
+
+void VoiceAllocator::setConfig(const Config& newConfig)
+{
+    config = newConfig;
+    config.firstChannel = juce::jlimit(0, 15, config.firstChannel);
+    config.lastChannel = juce::jlimit(config.firstChannel, 15, config.lastChannel);
+    config.numMemberChannels = juce::jlimit(1, 15, config.numMemberChannels);
+    reset();
+}
+
+void VoiceAllocator::reset()
+{
+    // Released voices were cleared already, so only the sounding ones need it
+    forEachActiveVoice([](Voice& voice) { voice = Voice{}; });
+
+    for (auto& channel : occupancy)
+        channel.fill(0);
+
+    // Pop order matches index order, which keeps allocation deterministic
+    numFreeVoices = maxVoices;
+    for (int i = 0; i < maxVoices; ++i)
+        freeVoices[(size_t) i] = static_cast<juce::uint8>(maxVoices - 1 - i);
+
+    activeVoices.clear();
+    numActiveVoices = 0;
+
+    freeChannels.clear();
+
+    int first = 0, last = -1;
+
+    switch (config.mode)
+    {
+        case Mode::inputChannel:  break;
+        case Mode::roundRobin:    first = config.firstChannel; last = config.lastChannel; break;
+        case Mode::mpeLowerZone:  first = 1; last = config.numMemberChannels; break;
+        case Mode::mpeUpperZone:  first = 15 - config.numMemberChannels; last = 14; break;
+    }
+
+    for (int channel = first; channel <= last; ++channel)
+        freeChannels.pushBack(channel);
+}
+
+VoiceAllocator::Voice& VoiceAllocator::noteOn(int inputChannel, int inputNote, Voice& displaced)
+{
+    jassert(juce::isPositiveAndBelow(inputChannel, 16) && juce::isPositiveAndBelow(inputNote, 128));
+
+    displaced = Voice{};
+
+    // A retriggered note replaces its previous voice
+    if (auto* existing = find(inputChannel, inputNote))
+    {
+        displaced = *existing;
+        release(*existing);
+    }
+
+    int outputChannel = inputChannel;
+
+    if (rotatesChannels())
+    {
+        if (freeChannels.head < 0)
+        {
+            // Every member channel is busy: steal the oldest voice
+            auto& oldest = voices[(size_t) activeVoices.head];
+            displaced = oldest;
+            release(oldest);
+        }
+
+        outputChannel = freeChannels.head;
+        freeChannels.remove(outputChannel);
+    }
+    else if (numFreeVoices == 0)
+    {
+        auto& oldest = voices[(size_t) activeVoices.head];
+        displaced = oldest;
+        release(oldest);
+    }
+
+    auto index = static_cast<int>(freeVoices[(size_t) --numFreeVoices]);
+    activeVoices.pushBack(index);
+    ++numActiveVoices;
+
+    // Also clears any glide left over, since reset() skips voices that weren't sounding
+    auto& voice = voices[(size_t) index];
+    voice = Voice{};
+    voice.inputChannel = static_cast<juce::int8>(inputChannel);
+    voice.inputNote = static_cast<juce::uint8>(inputNote);
+    voice.outputChannel = static_cast<juce::uint8>(outputChannel);
+    voice.outputNote = static_cast<juce::uint8>(inputNote);
+    voiceLookup[(size_t) inputChannel][(size_t) inputNote] = static_cast<juce::uint8>(index);
+    setOccupied(inputChannel, inputNote, true);
+
+    return voice;
+}
+
+VoiceAllocator::Voice* VoiceAllocator::find(int inputChannel, int inputNote)
+{
+    if (! juce::isPositiveAndBelow(inputChannel, 16) || ! juce::isPositiveAndBelow(inputNote, 128))
+        return nullptr;
+
+    if (! isOccupied(inputChannel, inputNote))
+        return nullptr;
+
+    return &voices[voiceLookup[(size_t) inputChannel][(size_t) inputNote]];
+}
+
+void VoiceAllocator::release(Voice& voice)
+{
+    jassert(voice.isActive());
+
+    auto index = indexOf(voice);
+    setOccupied(voice.inputChannel, voice.inputNote, false);
+
+    if (rotatesChannels())
+    {
+        // Released channels go to the back, so the least recently used is reused first
+        freeChannels.pushBack(voice.outputChannel);
+    }
+
+    activeVoices.remove(index);
+    --numActiveVoices;
+    freeVoices[(size_t) numFreeVoices++] = static_cast<juce::uint8>(index);
+
+    voice = Voice{};
+}
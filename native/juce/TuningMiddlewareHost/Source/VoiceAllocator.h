@@ -0,0 +1,156 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+
+/**
+ * VoiceAllocator - Assigns incoming notes to output channels
+ *
+ * In the channel-rotation modes every sounding voice owns one member channel, so
+ * each note gets its own pitch wheel. Free channels are handed out least recently
+ * used first; when none is left the oldest voice is stolen. Every operation is
+ * O(1) and allocation-free, so it runs on the audio thread.
+ *
+ * Voices are kept small and a per-channel occupancy bitset answers lookups, so a
+ * block's hot state stays within a few cache lines. reset() only touches voices
+ * that are sounding, which keeps all-notes-off cheap with many instances per core.
+ */
+class VoiceAllocator
+{
+public:
+    enum class Mode
+    {
+        inputChannel,   // voices stay on their incoming channel
+        roundRobin,     // rotate over firstChannel..lastChannel
+        mpeLowerZone,   // master channel 1, members 2..(1 + numMemberChannels)
+        mpeUpperZone    // master channel 16, members (16 - numMemberChannels)..15
+    };
+
+    struct Config
+    {
+        Mode mode = Mode::inputChannel;
+        int firstChannel = 0;           // 0-indexed, roundRobin only
+        int lastChannel = 15;
+        int numMemberChannels = 15;     // MPE zones only
+
+        bool operator== (const Config& other) const
+        {
+            return mode == other.mode
+                && firstChannel == other.firstChannel
+                && lastChannel == other.lastChannel
+                && numMemberChannels == other.numMemberChannels;
+        }
+
+        bool operator!= (const Config& other) const { return ! operator== (other); }
+    };
+
+    struct Voice
+    {
+        juce::int8 inputChannel = -1;   // 0-indexed, -1 while the voice is free
+        juce::uint8 inputNote = 0;
+        juce::uint8 outputChannel = 0;
+        juce::uint8 outputNote = 0;
+        juce::uint16 pitchBend = 8192;  // last bend sent for this voice
+
+        // Glide towards a retuned bend (glideLength 0 = idle). Times are the engine's
+        // sample clock modulo 2^32; a glide is far shorter than that, so the
+        // differences between them stay exact.
+        juce::uint16 glideFrom = 8192;
+        juce::uint16 glideTarget = 8192;
+        juce::int32 glideLength = 0;
+        juce::uint32 glideStart = 0;
+        juce::uint32 nextGlideStep = 0;
+
+        bool isActive() const { return inputChannel >= 0; }
+        bool isGliding() const { return glideLength > 0; }
+    };
+
+    static_assert(sizeof(Voice) <= 24, "voices should stay small enough to pack several per cache line");
+
+    static constexpr int maxVoices = 128;
+
+    VoiceAllocator();
+
+    // Drops all voices without notifying anyone; callers send their own note-offs
+    void setConfig(const Config& newConfig);
+    const Config& getConfig() const { return config; }
+
+    // Claims a voice for the note. If another voice had to make room (stolen, or
+    // the same note retriggered), a copy of it is written to `displaced`.
+    Voice& noteOn(int inputChannel, int inputNote, Voice& displaced);
+
+    // Voice currently playing the given incoming note, or nullptr
+    Voice* find(int inputChannel, int inputNote);
+
+    void release(Voice& voice);
+
+    template <typename Callback>
+    void forEachActiveVoice(Callback&& callback)
+    {
+        // The callback must not claim or release voices
+        for (auto index = activeVoices.head; index >= 0; index = activeVoices.links[(size_t) index].next)
+            callback(voices[(size_t) index]);
+    }
+
+    int getNumActiveVoices() const { return numActiveVoices; }
+
+    // Drops all voices and restores the configured channel order
+    void reset();
+
+private:
+    bool rotatesChannels() const { return config.mode != Mode::inputChannel; }
+
+    int indexOf(const Voice& voice) const { return static_cast<int>(&voice - voices.data()); }
+
+    bool isOccupied(int inputChannel, int inputNote) const
+    {
+        return ((occupancy[(size_t) inputChannel][(size_t) (inputNote >> 6)] >> (inputNote & 63)) & 1) != 0;
+    }
+
+    void setOccupied(int inputChannel, int inputNote, bool isHeld)
+    {
+        auto& word = occupancy[(size_t) inputChannel][(size_t) (inputNote >> 6)];
+        auto bit = juce::uint64 (1) << (inputNote & 63);
+        word = isHeld ? (word | bit) : (word & ~bit);
+    }
+
+    // Indices fit in 8 bits for every list we keep
+    struct Link
+    {
+        juce::int8 previous = -1;
+        juce::int8 next = -1;
+    };
+
+    // Intrusive doubly-linked list over a fixed array of links
+    template <size_t size>
+    struct LinkedList
+    {
+        std::array<Link, size> links;
+        int head = -1;
+        int tail = -1;
+
+        // Only walks the linked entries; unlinked ones are always reset already
+        void clear();
+        void pushBack(int index);
+        void remove(int index);
+    };
+
+    Config config;
+
+    std::array<Voice, maxVoices> voices {};
+
+    // Voice index per input note, only meaningful where the occupancy bit is set
+    std::array<std::array<juce::uint8, 128>, 16> voiceLookup {};
+    std::array<std::array<juce::uint64, 2>, 16> occupancy {};
+
+    // Free voices are kept on a stack, active ones ordered oldest first
+    std::array<juce::uint8, maxVoices> freeVoices;
+    int numFreeVoices = 0;
+    LinkedList<maxVoices> activeVoices;
+    int numActiveVoices = 0;
+
+    // Member channels not currently holding a voice, least recently used first
+    LinkedList<16> freeChannels;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(VoiceAllocator)
+};
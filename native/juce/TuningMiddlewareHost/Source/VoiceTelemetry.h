@@ -0,0 +1,79 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+#include <vector>
+
+/**
+ * VoiceTelemetry - Lock-free ring of voice events from the audio thread to the UI
+ *
+ * Single producer (processBlock), single consumer (an editor timer). When the
+ * ring is full new events are dropped and counted; the producer never waits.
+ */
+class VoiceTelemetry
+{
+public:
+    struct Event
+    {
+        enum class Type : juce::uint8
+        {
+            noteOn,
+            noteOff,
+            pitchBend
+        };
+
+        Type type = Type::noteOn;
+        juce::uint8 channel = 0;        // output channel, 0-indexed
+        juce::uint8 note = 0;           // output note
+        juce::uint8 inputNote = 0;      // the key that was played, for the lattice
+        juce::uint16 pitchBend = 8192;
+        juce::int32 samplePosition = 0;
+    };
+
+    explicit VoiceTelemetry(int capacity = 1024)
+        : fifo(capacity), events((size_t) capacity)
+    {
+    }
+
+    // Audio thread
+    void push(const Event& event) noexcept
+    {
+        int start1, size1, start2, size2;
+        fifo.prepareToWrite(1, start1, size1, start2, size2);
+
+        if (size1 + size2 == 0)
+        {
+            numDropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        events[(size_t) (size1 > 0 ? start1 : start2)] = event;
+        fifo.finishedWrite(1);
+    }
+
+    // Consumer thread: calls callback(const Event&) for everything pending
+    template <typename Callback>
+    int drain(Callback&& callback)
+    {
+        int start1, size1, start2, size2;
+        fifo.prepareToRead(fifo.getNumReady(), start1, size1, start2, size2);
+
+        for (int i = 0; i < size1; ++i)
+            callback(events[(size_t) (start1 + i)]);
+
+        for (int i = 0; i < size2; ++i)
+            callback(events[(size_t) (start2 + i)]);
+
+        fifo.finishedRead(size1 + size2);
+        return size1 + size2;
+    }
+
+    juce::int64 getNumDropped() const { return numDropped.load(std::memory_order_relaxed); }
+
+private:
+    juce::AbstractFifo fifo;
+    std::vector<Event> events;
+    std::atomic<juce::int64> numDropped { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(VoiceTelemetry)
+};
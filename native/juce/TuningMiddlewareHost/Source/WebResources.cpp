@@ -0,0 +1,120 @@
+#include "WebResources.h"
+#include "BinaryData.h"
+#include <map>
+
+namespace
+{
+    #if JUCE_WEB_BROWSER
+    struct Asset
+    {
+        const char* data = nullptr;
+        int size = 0;
+    };
+
+    Asset findAsset(const juce::String& fileName)
+    {
+        // A bundle is a few dozen files at most, so a scan beats building an index.
+        // BinaryData drops folders; the build rejects bundles where names repeat.
+        for (int i = 0; i < BinaryData::namedResourceListSize; ++i)
+        {
+            if (fileName == BinaryData::originalFilenames[i])
+            {
+                Asset asset;
+                asset.data = BinaryData::getNamedResource(BinaryData::namedResourceList[i], asset.size);
+                return asset;
+            }
+        }
+
+        return {};
+    }
+
+    // Inflated .gz assets, shared by every editor the process opens. Entries are
+    // never removed, so references to them stay valid outside the lock.
+    juce::CriticalSection inflatedLock;
+    std::map<juce::String, juce::MemoryBlock> inflatedAssets;
+
+    const juce::MemoryBlock& inflate(const juce::String& fileName, const Asset& compressed)
+    {
+        const juce::ScopedLock lock(inflatedLock);
+
+        auto found = inflatedAssets.find(fileName);
+        if (found != inflatedAssets.end())
+            return found->second;
+
+        juce::GZIPDecompressorInputStream stream(new juce::MemoryInputStream(compressed.data, (size_t) compressed.size, false),
+                                                 true, juce::GZIPDecompressorInputStream::gzipFormat);
+
+        auto& block = inflatedAssets[fileName];
+        stream.readIntoMemoryBlock(block);
+        return block;
+    }
+
+    juce::WebBrowserComponent::Resource makeResource(const void* data, size_t size, const juce::String& fileName)
+    {
+        // The provider API takes its own copy; this is the only one made
+        auto* bytes = static_cast<const std::byte*>(data);
+        return { std::vector<std::byte>(bytes, bytes + size), WebResources::getMimeType(fileName) };
+    }
+    #endif
+}
+
+namespace WebResources
+{
+    #if JUCE_WEB_BROWSER
+    std::optional<juce::WebBrowserComponent::Resource> find(const juce::String& path)
+    {
+        // Query strings and fragments don't select a different asset
+        auto fileName = path.upToFirstOccurrenceOf("?", false, false)
+                            .upToFirstOccurrenceOf("#", false, false)
+                            .fromLastOccurrenceOf("/", false, false);
+
+        if (fileName.isEmpty())
+            fileName = "index.html";
+
+        auto asset = findAsset(fileName);
+        if (asset.data != nullptr)
+            return makeResource(asset.data, (size_t) asset.size, fileName);
+
+        auto compressed = findAsset(fileName + ".gz");
+        if (compressed.data != nullptr)
+        {
+            const auto& block = inflate(fileName, compressed);
+            return makeResource(block.getData(), block.getSize(), fileName);
+        }
+
+        return std::nullopt;
+    }
+    #endif
+
+    const char* getMimeType(const juce::String& fileName)
+    {
+        static const char* const types[][2] = {
+            { "html",  "text/html" },
+            { "js",    "text/javascript" },
+            { "mjs",   "text/javascript" },
+            { "css",   "text/css" },
+            { "json",  "application/json" },
+            { "map",   "application/json" },
+            { "wasm",  "application/wasm" },
+            { "svg",   "image/svg+xml" },
+            { "png",   "image/png" },
+            { "jpg",   "image/jpeg" },
+            { "jpeg",  "image/jpeg" },
+            { "gif",   "image/gif" },
+            { "webp",  "image/webp" },
+            { "ico",   "image/x-icon" },
+            { "woff",  "font/woff" },
+            { "woff2", "font/woff2" },
+            { "ttf",   "font/ttf" },
+            { "txt",   "text/plain" }
+        };
+
+        auto extension = fileName.fromLastOccurrenceOf(".", false, false).toLowerCase();
+
+        for (const auto& type : types)
+            if (extension == type[0])
+                return type[1];
+
+        return "application/octet-stream";
+    }
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <optional>
+
+/**
+ * WebResources - Serves the embedded webapp to the WebView from BinaryData
+ *
+ * Everything under Resources/webapp is compiled in, so the page loads from the
+ * resource provider root instead of a data: URL that has to be re-encoded and
+ * re-parsed on every editor open. Assets are found by file name; one stored as
+ * name.gz is inflated the first time it is asked for and kept for the process.
+ */
+namespace WebResources
+{
+    #if JUCE_WEB_BROWSER
+    // For a request path from the provider ("/" serves index.html)
+    std::optional<juce::WebBrowserComponent::Resource> find(const juce::String& path);
+    #endif
+
+    // From the file extension; application/octet-stream when unknown
+    const char* getMimeType(const juce::String& fileName);
+}
@@ -1,4 +1,5 @@
 #include "WebViewComponent.h"
+#include "WebResources.h"
 
 WebViewComponent::WebViewComponent(RpcBridge& bridge)
     : rpcBridge(bridge)
@@ -8,52 +9,29 @@ WebViewComponent::WebViewComponent(RpcBridge& bridge)
         juce::WebBrowserComponent::Options()
             .withBackend(juce::WebBrowserComponent::Options::Backend::webview2)
             .withNativeIntegrationEnabled()
-            .withResourceProvider([](const auto& url) -> std::optional<juce::WebBrowserComponent::Resource>
+            .withKeepPageLoadedWhenBrowserIsHidden()
+            .withResourceProvider([](const auto& url)
             {
-                // Resource provider for embedded content
-                return std::nullopt;
+                // The webapp is compiled in; see WebResources
+                return WebResources::find(url);
             })
     );
     
     addAndMakeVisible(*browser);
 
-    // Set up event callback to send to WebView
-    rpcBridge.setEventCallback([this](const juce::String& json)
+    // Set up event callback to send to WebView; one script runs per batch
+    rpcBridge.setEventCallback([this](const juce::String& eventsJson)
     {
         if (browser)
         {
-            // Send event to JavaScript
-            juce::String script = "window.dispatchEvent(new CustomEvent('native-event', { detail: " + json + " }));";
+            // Send events to JavaScript
+            juce::String script = "(events => events.forEach(e => window.dispatchEvent(new CustomEvent('native-event', { detail: e }))))(" + eventsJson + ");";
             browser->evaluateJavascript(script, nullptr);
         }
     });
 
-    // Load default content
-    loadHTML(R"(
-        <!DOCTYPE html>
-        <html>
-        <head>
-            <meta charset="UTF-8">
-            <title>Tuning Middleware Host</title>
-            <style>
-                body {
-                    font-family: -apple-system, BlinkMacSystemFont, 'Segoe UI', Roboto, sans-serif;
-                    background: #1a1a1a;
-                    color: #fff;
-                    margin: 0;
-                    padding: 20px;
-                }
-                h1 { color: #4a9eff; }
-                .status { color: #4ade80; }
-            </style>
-        </head>
-        <body>
-            <h1>Tuning Middleware Host</h1>
-            <p class="status">Plugin loaded successfully</p>
-            <p>WebView UI placeholder - React app will be embedded here.</p>
-        </body>
-        </html>
-    )");
+    // Load the embedded webapp
+    loadURL(juce::WebBrowserComponent::getResourceProviderRoot());
     #endif
 }
 
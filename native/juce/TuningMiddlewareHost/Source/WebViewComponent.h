@@ -5,6 +5,9 @@
 
 /**
  * WebViewComponent - Embeds WebView for React UI
+ *
+ * The processor keeps one alive for its whole lifetime and editors borrow it, so
+ * the page stays loaded while the editor is closed.
  */
 class WebViewComponent : public juce::Component
 {
@@ -14,7 +17,7 @@ public:
 
     void resized() override;
 
-    // Load URL or HTML content
+    // Load URL or HTML content; the embedded webapp is loaded on construction
     void loadURL(const juce::String& url);
     void loadHTML(const juce::String& html);
 
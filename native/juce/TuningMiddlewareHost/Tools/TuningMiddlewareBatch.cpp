@@ -0,0 +1,488 @@
+/*
+    TuningMiddlewareBatch - Retunes standard MIDI files offline with TuningEngine
+
+    Each file is played through a fresh engine restored from a saved state, the
+    same processBlock() the plugin runs, in large blocks and as fast as the CPU
+    allows. Files are spread over one worker thread per core:
+        TuningMiddlewareBatch --state <tuning.tmst> [--output <dir>] [--suffix <text>]
+                              [--jobs <n>] [--block-size <n>] [--sample-rate <hz>] <file.mid | dir>...
+
+    The state is a file written by state.save, or any saved processor state,
+    including the table-only layout of sessions older than the chunked format.
+    Directories are searched recursively for .mid and .midi files. Without
+    --output each result is written next to its input with the suffix added
+    (default "-retuned"); with it, results keep their names and the layout
+    below each directory argument.
+
+    All tracks play into one engine, as they would into the plugin. Meta and
+    system exclusive events stay in their tracks; channel events go to the first
+    track that used their input channel, or to the first track with channel
+    events in the rotation and MPE modes, where voices change channel. A .mid
+    file only carries MIDI 1.0, so the output protocol is always MIDI 1.0.
+
+    Prints one JSON object with the totals; exits with 1 when any file failed.
+*/
+
+#include <JuceHeader.h>
+#include "../Source/TuningEngine.h"
+#include "../Source/StateFormat.h"
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    struct Options
+    {
+        juce::File state;
+        juce::File outputFolder;
+        juce::String suffix = "-retuned";
+        int numJobs = juce::SystemStats::getNumCpuCores();
+        int blockSize = 65536;
+        double sampleRate = 48000.0;
+        juce::StringArray inputs;
+    };
+
+    bool parseOptions(int argc, char* argv[], Options& options)
+    {
+        auto cwd = juce::File::getCurrentWorkingDirectory();
+
+        for (int i = 1; i < argc; ++i)
+        {
+            juce::String arg(argv[i]);
+            auto hasValue = i + 1 < argc;
+
+            if (arg == "--state" && hasValue)
+                options.state = cwd.getChildFile(argv[++i]);
+            else if (arg == "--output" && hasValue)
+                options.outputFolder = cwd.getChildFile(argv[++i]);
+            else if (arg == "--suffix" && hasValue)
+                options.suffix = argv[++i];
+            else if (arg == "--jobs" && hasValue)
+                options.numJobs = juce::jmax(1, juce::String(argv[++i]).getIntValue());
+            else if (arg == "--block-size" && hasValue)
+                options.blockSize = juce::jlimit(64, 1 << 20, juce::String(argv[++i]).getIntValue());
+            else if (arg == "--sample-rate" && hasValue)
+                options.sampleRate = juce::jlimit(8000.0, 768000.0, juce::String(argv[++i]).getDoubleValue());
+            else if (! arg.startsWith("--"))
+                options.inputs.add(arg);
+            else
+                return false;
+        }
+
+        // In place with no suffix would overwrite the inputs
+        auto writesOverInputs = options.outputFolder == juce::File() && options.suffix.isEmpty();
+        return options.state != juce::File() && ! options.inputs.isEmpty() && ! writesOverInputs;
+    }
+
+    struct Job
+    {
+        juce::File input, output;
+    };
+
+    void findJobs(const Options& options, std::vector<Job>& jobs)
+    {
+        auto cwd = juce::File::getCurrentWorkingDirectory();
+
+        auto outputFor = [&options](const juce::File& input, const juce::File& root)
+        {
+            if (options.outputFolder != juce::File())
+                return options.outputFolder.getChildFile(root != juce::File() ? input.getRelativePathFrom(root)
+                                                                              : input.getFileName());
+
+            return input.getSiblingFile(input.getFileNameWithoutExtension() + options.suffix + input.getFileExtension());
+        };
+
+        for (const auto& path : options.inputs)
+        {
+            auto input = cwd.getChildFile(path);
+
+            if (! input.isDirectory())
+            {
+                jobs.push_back({ input, outputFor(input, {}) });
+                continue;
+            }
+
+            auto files = input.findChildFiles(juce::File::findFiles, true, "*.mid;*.midi");
+            files.sort();
+
+            for (const auto& file : files)
+            {
+                // A rerun in place would otherwise retune its own results again
+                if (options.outputFolder == juce::File() && file.getFileNameWithoutExtension().endsWith(options.suffix))
+                    continue;
+
+                jobs.push_back({ file, outputFor(file, input) });
+            }
+        }
+    }
+
+    /**
+     * Tick <-> seconds for one file. Tempo changes split the file into segments
+     * of constant seconds per tick; SMPTE files have a single segment.
+     */
+    class TempoMap
+    {
+    public:
+        explicit TempoMap(const juce::MidiFile& file)
+        {
+            auto timeFormat = (int) file.getTimeFormat();
+
+            if (timeFormat < 0)
+            {
+                auto framesPerSecond = -(timeFormat >> 8);
+                auto rate = framesPerSecond == 29 ? 30000.0 / 1001.0 : (double) framesPerSecond;
+                segments.push_back({ 0.0, 0.0, 1.0 / (rate * (timeFormat & 0xff)) });
+                return;
+            }
+
+            // 120 bpm until the first tempo event
+            auto ticksPerQuarterNote = (double) juce::jmax(1, timeFormat);
+            segments.push_back({ 0.0, 0.0, 0.5 / ticksPerQuarterNote });
+
+            juce::MidiMessageSequence tempoEvents;
+            file.findAllTempoEvents(tempoEvents);
+            tempoEvents.sort();
+
+            for (const auto* holder : tempoEvents)
+            {
+                auto tick = holder->message.getTimeStamp();
+                auto secondsPerTick = holder->message.getTempoSecondsPerQuarterNote() / ticksPerQuarterNote;
+                auto& last = segments.back();
+
+                if (tick <= last.tick)
+                    last.secondsPerTick = secondsPerTick;
+                else
+                    segments.push_back({ tick, getSeconds(tick), secondsPerTick });
+            }
+        }
+
+        double getSeconds(double tick) const
+        {
+            auto segment = std::upper_bound(segments.begin() + 1, segments.end(), tick,
+                                            [](double t, const Segment& s) { return t < s.tick; }) - 1;
+            return segment->seconds + (tick - segment->tick) * segment->secondsPerTick;
+        }
+
+        double getTicks(double seconds) const
+        {
+            auto segment = std::upper_bound(segments.begin() + 1, segments.end(), seconds,
+                                            [](double t, const Segment& s) { return t < s.seconds; }) - 1;
+            return segment->tick + (seconds - segment->seconds) / segment->secondsPerTick;
+        }
+
+    private:
+        struct Segment
+        {
+            double tick, seconds, secondsPerTick;
+        };
+
+        std::vector<Segment> segments;
+    };
+
+    struct FileResult
+    {
+        juce::String error;
+        juce::int64 eventsIn = 0, eventsOut = 0;
+        double seconds = 0.0;
+    };
+
+    bool isChannelEvent(const juce::MidiMessage& message)
+    {
+        auto status = message.getRawData()[0];
+        return status >= 0x80 && status < 0xf0;
+    }
+
+    FileResult retuneFile(const Job& job, const Options& options, const StateFormat::EngineState& state)
+    {
+        FileResult result;
+        juce::MidiFile source;
+        int fileType = 1;
+
+        {
+            juce::FileInputStream stream(job.input);
+
+            if (! stream.openedOk() || ! source.readFrom(stream, false, &fileType))
+            {
+                result.error = "Can't read " + job.input.getFullPathName();
+                return result;
+            }
+        }
+
+        const TempoMap tempoMap(source);
+        auto numTracks = source.getNumTracks();
+
+        // Every channel event of every track, in playing order, at its sample
+        struct Event
+        {
+            juce::int64 sample;
+            int track;
+            const juce::MidiMessage* message;
+        };
+
+        std::vector<Event> events;
+        double endTick = 0.0;
+
+        for (int track = 0; track < numTracks; ++track)
+        {
+            for (const auto* holder : *source.getTrack(track))
+            {
+                endTick = juce::jmax(endTick, holder->message.getTimeStamp());
+
+                if (isChannelEvent(holder->message))
+                {
+                    auto seconds = tempoMap.getSeconds(holder->message.getTimeStamp());
+                    events.push_back({ juce::roundToLargestInt(seconds * options.sampleRate), track, &holder->message });
+                }
+            }
+        }
+
+        // By tick, which also orders by sample, so events sharing a sample keep their order
+        std::stable_sort(events.begin(), events.end(), [](const Event& a, const Event& b)
+        {
+            return a.message->getTimeStamp() < b.message->getTimeStamp();
+        });
+
+        TuningEngine engine;
+        engine.prepare(options.sampleRate, options.blockSize);
+        StateFormat::restoreTuningEngine(state, engine);
+        engine.setOutputProtocol(TuningEngine::OutputProtocol::midi1);
+
+        int channelTracks[16];
+        std::fill(std::begin(channelTracks), std::end(channelTracks), -1);
+
+        for (const auto& event : events)
+        {
+            auto& owner = channelTracks[event.message->getRawData()[0] & 0x0f];
+            owner = owner < 0 ? event.track : owner;
+        }
+
+        if (engine.getVoiceAllocation().mode != VoiceAllocator::Mode::inputChannel && ! events.empty())
+            std::fill(std::begin(channelTracks), std::end(channelTracks), events.front().track);
+
+        std::vector<juce::MidiMessageSequence> retuned((size_t) numTracks);
+        juce::MidiBuffer buffer;
+        size_t next = 0;
+        double lastTick = 0.0;
+        auto endSample = events.empty() ? juce::int64 { 0 } : events.back().sample + 1;
+
+        // Glides started near the end run on past the last event; the bound only
+        // guarantees the loop ends
+        auto glideSamples = (juce::int64) std::ceil(engine.getRetuneGlideMilliseconds() * 0.001 * options.sampleRate);
+        auto tailEndSample = endSample + glideSamples + 2 * (juce::int64) options.blockSize;
+
+        for (juce::int64 blockStart = 0;
+             blockStart < endSample || (engine.hasActiveGlides() && blockStart < tailEndSample);
+             blockStart += options.blockSize)
+        {
+            auto numSamples = blockStart < endSample ? (int) juce::jmin((juce::int64) options.blockSize, endSample - blockStart)
+                                                     : options.blockSize;
+            auto blockFirst = next;
+            buffer.clear();
+
+            for (; next < events.size() && events[next].sample < blockStart + numSamples; ++next)
+            {
+                const auto& message = *events[next].message;
+                buffer.addEvent(message.getRawData(), message.getRawDataSize(), (int) (events[next].sample - blockStart));
+            }
+
+            result.eventsIn += buffer.getNumEvents();
+            engine.processBlock(buffer, numSamples);
+
+            // Input events keep their own ticks, as samples can't be turned back into
+            // ticks exactly. What the engine writes at an input's position, ahead of
+            // it or in its place, takes that input's tick; a matching status rewrites
+            // the input and moves on to the next. Only events between inputs, such as
+            // glide steps, are placed from their sample.
+            auto source = blockFirst;
+
+            for (const auto metadata : buffer)
+            {
+                auto sample = blockStart + metadata.samplePosition;
+                auto type = metadata.data[0] & 0xf0;
+                auto sourceType = [&] { return events[source].message->getRawData()[0] & 0xf0; };
+
+                // A wheel the engine consumed without sending a bend has nothing here
+                while (source < next && (events[source].sample < sample
+                                         || (events[source].sample == sample && sourceType() == 0xe0 && type != 0xe0)))
+                    ++source;
+
+                double tick;
+
+                if (source < next && events[source].sample == sample)
+                {
+                    tick = events[source].message->getTimeStamp();
+
+                    if (type == sourceType())
+                        ++source;
+                }
+                else
+                {
+                    tick = (double) juce::roundToLargestInt(tempoMap.getTicks((double) sample / options.sampleRate));
+                }
+
+                tick = juce::jmax(tick, lastTick);
+                lastTick = tick;
+
+                auto track = channelTracks[metadata.data[0] & 0x0f];
+
+                retuned[(size_t) juce::jmax(0, track)].addEvent(juce::MidiMessage(metadata.data, metadata.numBytes, tick));
+                ++result.eventsOut;
+            }
+        }
+
+        // Meta and sysex events keep their tracks and go ahead of channel events
+        // at the same tick; end of track goes after everything
+        juce::MidiFile output;
+        auto timeFormat = (int) source.getTimeFormat();
+
+        if (timeFormat < 0)
+            output.setSmpteTimeFormat(-(timeFormat >> 8), timeFormat & 0xff);
+        else
+            output.setTicksPerQuarterNote(timeFormat);
+
+        for (int track = 0; track < numTracks; ++track)
+        {
+            juce::MidiMessageSequence sequence;
+            const auto& channelEvents = retuned[(size_t) track];
+            int channelIndex = 0;
+            double endOfTrack = -1.0;
+
+            for (const auto* holder : *source.getTrack(track))
+            {
+                const auto& message = holder->message;
+
+                if (isChannelEvent(message))
+                    continue;
+
+                if (message.isEndOfTrackMetaEvent())
+                {
+                    endOfTrack = message.getTimeStamp();
+                    continue;
+                }
+
+                for (; channelIndex < channelEvents.getNumEvents()
+                       && channelEvents.getEventTime(channelIndex) < message.getTimeStamp(); ++channelIndex)
+                    sequence.addEvent(channelEvents.getEventPointer(channelIndex)->message);
+
+                sequence.addEvent(message);
+            }
+
+            for (; channelIndex < channelEvents.getNumEvents(); ++channelIndex)
+                sequence.addEvent(channelEvents.getEventPointer(channelIndex)->message);
+
+            if (endOfTrack >= 0.0)
+                sequence.addEvent(juce::MidiMessage::endOfTrack(), juce::jmax(endOfTrack, sequence.getEndTime()));
+
+            output.addTrack(sequence);
+        }
+
+        juce::MemoryOutputStream contents;
+
+        if (! output.writeTo(contents, fileType)
+            || ! job.output.getParentDirectory().createDirectory()
+            || ! job.output.replaceWithData(contents.getData(), contents.getDataSize()))
+        {
+            result.error = "Can't write " + job.output.getFullPathName();
+            return result;
+        }
+
+        result.seconds = tempoMap.getSeconds(endTick);
+        return result;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+
+    if (! parseOptions(argc, argv, options))
+    {
+        std::cerr << "usage: TuningMiddlewareBatch --state <tuning.tmst> [--output <dir>] [--suffix <text>]" << std::endl
+                  << "                            [--jobs <n>] [--block-size <n>] [--sample-rate <hz>] <file.mid | dir>..." << std::endl;
+        return 1;
+    }
+
+    juce::MemoryBlock stateData;
+    StateFormat::EngineState state;
+
+    {
+        if (! options.state.loadFileAsData(stateData))
+        {
+            std::cerr << "Can't read " << options.state.getFullPathName() << std::endl;
+            return 1;
+        }
+
+        StateFormat::Reader reader(stateData.getData(), stateData.getSize());
+        StateFormat::Chunk chunk;
+
+        while (reader.next(chunk))
+            StateFormat::readTuningEngineChunk(chunk, state);
+
+        // As the processor reads it, so any state it restores retunes the same here
+        if (! reader.isValid() && ! StateFormat::readLegacyTuningEngine(stateData.getData(), stateData.getSize(), state))
+        {
+            std::cerr << options.state.getFullPathName() << " isn't a tuning state" << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<Job> jobs;
+    findJobs(options, jobs);
+
+    // Each worker takes the next file until none is left; results stay in input order
+    std::vector<FileResult> results(jobs.size());
+    std::atomic<size_t> nextJob { 0 };
+    auto startTicks = juce::Time::getHighResolutionTicks();
+
+    auto work = [&]
+    {
+        for (auto index = nextJob++; index < jobs.size(); index = nextJob++)
+            results[index] = retuneFile(jobs[index], options, state);
+    };
+
+    std::vector<std::thread> workers;
+    auto numWorkers = (size_t) juce::jlimit(1, juce::jmax(1, (int) jobs.size()), options.numJobs);
+
+    for (size_t i = 1; i < numWorkers; ++i)
+        workers.emplace_back(work);
+
+    work();
+
+    for (auto& worker : workers)
+        worker.join();
+
+    auto elapsedSeconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks);
+    juce::int64 eventsIn = 0, eventsOut = 0;
+    double musicSeconds = 0.0;
+    int numFailed = 0;
+
+    for (const auto& result : results)
+    {
+        if (result.error.isNotEmpty())
+        {
+            std::cerr << result.error << std::endl;
+            ++numFailed;
+            continue;
+        }
+
+        eventsIn += result.eventsIn;
+        eventsOut += result.eventsOut;
+        musicSeconds += result.seconds;
+    }
+
+    std::cout << "{\"tool\":\"tuningMiddlewareBatch\""
+              << ",\"files\":" << jobs.size()
+              << ",\"failed\":" << numFailed
+              << ",\"jobs\":" << numWorkers
+              << ",\"eventsIn\":" << eventsIn
+              << ",\"eventsOut\":" << eventsOut
+              << ",\"musicSeconds\":" << musicSeconds
+              << ",\"elapsedSeconds\":" << elapsedSeconds
+              << ",\"realtimeFactor\":" << (elapsedSeconds > 0.0 ? musicSeconds / elapsedSeconds : 0.0)
+              << "}" << std::endl;
+
+    return numFailed == 0 ? 0 : 1;
+}